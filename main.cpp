@@ -1,11 +1,51 @@
+#include "utils/batch.h"
 #include "utils/error.h"
+#include "utils/mapped_file.h"
+#include "utils/printer.h"
+#include "utils/reader.h"
 #include "utils/scheme.h"
+#include "utils/server.h"
 
+#include <algorithm>
+#include <charconv>
+#include <csignal>
+#include <cstddef>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include <unistd.h>
 
-int main() {
-    Interpreter interpreter;
+namespace {
+
+constexpr size_t kChunkSize = 1 << 16;
+
+// What every interpreter starts from: an image, then the files loaded.
+struct Startup {
+    std::optional<std::string> image;
+    std::vector<std::string> preludes;
+};
+
+// Reports a failed query on stderr and returns false.
+bool Run(Interpreter &interpreter, std::string_view query,
+         std::string *result) {
+    if (interpreter.TryRun(query, result)) {
+        return true;
+    }
+
+    std::cout.flush();
+    std::cerr << "Caught " << *result << std::endl;
+
+    return false;
+}
+
+void RunRepl(Interpreter &interpreter) {
     std::string query;
+    std::string result;
 
     while (true) {
         std::cout << "$ ";
@@ -15,19 +55,285 @@ int main() {
             break;
         }
 
-        try {
-            auto result = interpreter.Run(query);
+        if (Run(interpreter, query, &result)) {
             std::cout << "> " << result << std::endl;
-        } catch (const SyntaxError &syntax_error) {
-            std::cerr << "Caught SyntaxError: " << syntax_error.what()
-                      << std::endl;
-        } catch (const NameError &name_error) {
-            std::cerr << "Caught NameError: " << name_error.what() << std::endl;
-        } catch (const RuntimeError &runtime_error) {
-            std::cerr << "Caught RuntimeError: " << runtime_error.what()
+        }
+    }
+}
+
+// Runs every complete datum fed so far, printing one result per line.
+bool RunData(Interpreter &interpreter, Reader *reader, Printer *printer) {
+    std::string error;
+    bool succeeded = true;
+
+    while (auto datum = reader->Next()) {
+        if (interpreter.TryRun(*datum, printer, &error)) {
+            printer->Write("\n");
+        } else {
+            printer->Flush();
+            std::cerr << "Caught " << error << std::endl;
+            succeeded = false;
+        }
+    }
+
+    return succeeded;
+}
+
+// Results go straight to the standard output, without std::cout.
+bool RunFile(Interpreter &interpreter, const std::string &path) {
+    MappedFile file{path};
+    Reader reader;
+    Printer printer{STDOUT_FILENO};
+
+    reader.Feed(file.GetView());
+    reader.Finish();
+
+    bool succeeded = RunData(interpreter, &reader, &printer);
+    printer.Flush();
+
+    return succeeded;
+}
+
+// Data may span chunks, so each one is run as soon as it is complete.
+bool RunStream(Interpreter &interpreter, std::istream &input) {
+    std::string chunk(kChunkSize, '\0');
+    Reader reader;
+    Printer printer{STDOUT_FILENO};
+    bool succeeded = true;
+
+    while (input.read(chunk.data(), chunk.size()) || input.gcount() != 0) {
+        reader.Feed(std::string_view{chunk.data(),
+                                     static_cast<size_t>(input.gcount())});
+        succeeded &= RunData(interpreter, &reader, &printer);
+    }
+
+    reader.Finish();
+    succeeded &= RunData(interpreter, &reader, &printer);
+    printer.Flush();
+
+    return succeeded;
+}
+
+// All the data of the files, or of the standard input without files, are
+// read up front and run by the batch runner.
+bool RunBatch(size_t workers, const std::vector<std::string> &paths,
+              const Startup &startup) {
+    std::vector<std::unique_ptr<MappedFile>> files;
+    std::vector<std::unique_ptr<Reader>> readers;
+    std::vector<std::string_view> data;
+
+    for (const auto &path : paths) {
+        files.push_back(std::make_unique<MappedFile>(path));
+        readers.push_back(std::make_unique<Reader>());
+        readers.back()->Feed(files.back()->GetView());
+    }
+
+    if (paths.empty()) {
+        std::string chunk(kChunkSize, '\0');
+
+        readers.push_back(std::make_unique<Reader>());
+
+        while (std::cin.read(chunk.data(), chunk.size()) ||
+               std::cin.gcount() != 0) {
+            readers.back()->Feed(std::string_view{
+                chunk.data(), static_cast<size_t>(std::cin.gcount())});
+        }
+    }
+
+    for (auto &reader : readers) {
+        reader->Finish();
+
+        while (auto datum = reader->Next()) {
+            data.push_back(*datum);
+        }
+    }
+
+    BatchRunner runner{workers};
+    bool succeeded = true;
+
+    if (startup.image) {
+        runner.LoadImage(*startup.image);
+    }
+    for (const auto &prelude : startup.preludes) {
+        runner.Load(prelude);
+    }
+
+    for (const auto &result : runner.Run(data)) {
+        if (result.failed) {
+            std::cout.flush();
+            std::cerr << "Caught " << result.output << std::endl;
+            succeeded = false;
+        } else {
+            std::cout << result.output << '\n';
+        }
+    }
+
+    return succeeded;
+}
+
+Server *running_server = nullptr;
+
+void StopServer(int) { running_server->Stop(); }
+
+bool Serve(const std::string &address, size_t workers,
+           const Startup &startup) {
+    Server::Options options;
+    options.workers = std::max<size_t>(workers, 1);
+    options.image = startup.image.value_or("");
+    options.preludes = startup.preludes;
+
+    // a port number or the path of a Unix domain socket
+    auto [end, error] = std::from_chars(
+        address.data(), address.data() + address.size(), options.port);
+
+    if (error != std::errc{} || end != address.data() + address.size()) {
+        options.path = address;
+    }
+
+    Server server{options};
+
+    running_server = &server;
+    std::signal(SIGINT, StopServer);
+    std::signal(SIGTERM, StopServer);
+
+    server.Run();
+
+    return true;
+}
+
+// Reports the first file that fails to load and returns false.
+bool Start(Interpreter &interpreter, const Startup &startup) {
+    if (startup.image) {
+        try {
+            interpreter.LoadImage(*startup.image);
+        } catch (const std::runtime_error &error) {
+            std::cerr << "Cannot load image " << *startup.image << ": "
+                      << error.what() << std::endl;
+            return false;
+        }
+    }
+
+    for (const auto &prelude : startup.preludes) {
+        try {
+            interpreter.Load(prelude);
+        } catch (const std::runtime_error &error) {
+            std::cerr << "Cannot load " << prelude << ": " << error.what()
                       << std::endl;
-        } catch (...) {
-            std::cerr << "Caught unknown exception" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+// scheme file.scm runs the file, input from a pipe is run the same way and
+// a terminal gets the REPL. Scripts print the result of every top-level
+// datum on its own line. scheme -j N [file...] runs the data of the files
+// or of the input in parallel on N threads. scheme --listen PORT|PATH
+// [-j N] serves queries on localhost TCP or a Unix domain socket with N
+// interpreters. --metrics PATH profiles the REPL or a script and writes
+// OpenMetrics text to PATH on exit. --load PATH, which may be repeated,
+// loads a file into every interpreter first, through a fasl cache (see
+// Interpreter::Load). --image PATH restores a heap image into every
+// interpreter before that, --save-image PATH writes one of the REPL or a
+// script on exit.
+int main(int argc, char **argv) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    size_t workers = 0;
+    std::optional<std::string> address;
+    std::optional<std::string> metrics;
+    std::optional<std::string> save_image;
+    Startup startup;
+
+    while (args.size() >= 2 &&
+           (args[0] == "-j" || args[0] == "--listen" ||
+            args[0] == "--metrics" || args[0] == "--load" ||
+            args[0] == "--image" || args[0] == "--save-image")) {
+        const auto &value = args[1];
+
+        if (args[0] == "--listen") {
+            address = value;
+        } else if (args[0] == "--load") {
+            startup.preludes.push_back(value);
+        } else if (args[0] == "--image") {
+            startup.image = value;
+        } else if (args[0] == "--save-image") {
+            save_image = value;
+        } else if (args[0] == "--metrics") {
+            metrics = value;
+        } else if (auto [end, error] = std::from_chars(
+                       value.data(), value.data() + value.size(), workers);
+                   error != std::errc{} ||
+                   end != value.data() + value.size() || workers == 0) {
+            std::cerr << "Invalid number of threads: " << value << std::endl;
+            return 1;
         }
+
+        args.erase(args.begin(), args.begin() + 2);
+    }
+
+    if (metrics && (address || workers != 0)) {
+        std::cerr << "--metrics needs a single interpreter" << std::endl;
+        return 1;
     }
+    if (save_image && (address || workers != 0)) {
+        std::cerr << "--save-image needs a single interpreter" << std::endl;
+        return 1;
+    }
+
+    Interpreter interpreter;
+    interpreter.SetProfiling(metrics.has_value());
+
+    bool succeeded = false;
+
+    // the server and the batch runner load them into their own interpreters
+    if (!address && workers == 0 && !Start(interpreter, startup)) {
+        return 1;
+    }
+
+    if (!address && workers == 0 && args.empty() && isatty(STDIN_FILENO)) {
+        RunRepl(interpreter);
+        succeeded = true;
+    } else {
+        std::ios::sync_with_stdio(false);
+
+        try {
+            if (address) {
+                succeeded = Serve(*address, workers, startup);
+            } else if (workers != 0) {
+                succeeded = RunBatch(workers, args, startup);
+            } else if (!args.empty()) {
+                succeeded = RunFile(interpreter, args[0]);
+            } else {
+                succeeded = RunStream(interpreter, std::cin);
+            }
+        } catch (const std::runtime_error &error) {
+            std::cerr << error.what() << std::endl;
+        }
+
+        std::cout.flush();
+    }
+
+    if (save_image) {
+        try {
+            interpreter.SaveImage(*save_image);
+        } catch (const std::runtime_error &error) {
+            std::cerr << error.what() << std::endl;
+            succeeded = false;
+        }
+    }
+
+    if (metrics) {
+        std::ofstream out{*metrics};
+        interpreter.GetProfiler().WriteOpenMetrics(out);
+
+        if (!out) {
+            std::cerr << "Cannot write metrics to " << *metrics << std::endl;
+            succeeded = false;
+        }
+    }
+
+    return succeeded ? 0 : 1;
 }
@@ -0,0 +1,45 @@
+#include "utils/arena.h"
+#include "utils/base_object.h"
+
+#include <algorithm>
+
+Arena::~Arena() { Reset(); }
+
+void Arena::Reset() {
+    for (Object *object : finalizers_) {
+        object->~Object();
+    }
+
+    finalizers_.clear();
+    current_chunk_ = 0;
+    offset_ = 0;
+    bytes_ = 0;
+}
+
+void *Arena::Allocate(size_t size, size_t alignment) {
+    while (current_chunk_ < chunks_.size()) {
+        Chunk &chunk = chunks_[current_chunk_];
+        size_t begin = (offset_ + alignment - 1) & ~(alignment - 1);
+
+        if (begin + size <= chunk.size) {
+            offset_ = begin + size;
+            bytes_ += size;
+            return chunk.data.get() + begin;
+        }
+
+        ++current_chunk_;
+        offset_ = 0;
+    }
+
+    size_t chunk_size = std::max(kMinChunkSize, size + alignment);
+    if (!chunks_.empty()) {
+        chunk_size = std::max(chunk_size, chunks_.back().size * 2);
+    }
+
+    chunks_.push_back({std::unique_ptr<std::byte[]>{new std::byte[chunk_size]},
+                       chunk_size});
+    current_chunk_ = chunks_.size() - 1;
+    offset_ = 0;
+
+    return Allocate(size, alignment);
+}
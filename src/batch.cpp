@@ -0,0 +1,323 @@
+#include "utils/batch.h"
+#include "utils/mapped_file.h"
+#include "utils/reader.h"
+#include "utils/scheme.h"
+#include "utils/symbol_table.h"
+#include "utils/tokenizer.h"
+
+#include <algorithm>
+#include <barrier>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+// Data [begin, end) to spread over the workers, or a single barrier datum.
+struct Segment {
+    size_t begin;
+    size_t end;
+    bool barrier;
+};
+
+// What a datum says about the globals, read off its tokens.
+struct DatumSymbols {
+    std::vector<std::string_view> symbols;
+    // names defined at the top level, which includes the forms of a
+    // top-level begin, or assigned with set! anywhere
+    std::vector<std::string_view> assigned;
+    bool definition = false;
+};
+
+DatumSymbols ScanDatum(std::string_view datum) {
+    DatumSymbols result;
+    size_t depth = 0;
+    // the brackets up to this depth all open top-level begin forms
+    size_t toplevel = 0;
+    auto text = [datum](const TokenSpan &token) {
+        return datum.substr(token.begin, token.end - token.begin);
+    };
+
+    for (auto token = ScanToken(datum, 0); token;
+         token = ScanToken(datum, token->end)) {
+        if (token->type == TokenType::Symbol) {
+            result.symbols.push_back(text(*token));
+            continue;
+        }
+        if (token->type == TokenType::CloseBracket) {
+            depth -= depth != 0;
+            toplevel = std::min(toplevel, depth);
+            continue;
+        }
+        if (token->type != TokenType::OpenBracket) {
+            continue;
+        }
+
+        bool form = depth++ == toplevel;
+        auto name = ScanToken(datum, token->end);
+
+        if (!name || name->type != TokenType::Symbol) {
+            continue;
+        }
+
+        // the name of (define name ...), (define (name ...) ...) and
+        // (set! name ...)
+        auto target = ScanToken(datum, name->end);
+        if (target && target->type == TokenType::OpenBracket) {
+            target = ScanToken(datum, target->end);
+        }
+        bool named = target && target->type == TokenType::Symbol;
+
+        if (form && text(*name) == "define") {
+            result.definition = true;
+        } else if (form && text(*name) == "begin") {
+            toplevel = depth;
+        } else if (text(*name) != "set!") {
+            continue;
+        }
+
+        if (named) {
+            result.assigned.push_back(text(*target));
+        }
+    }
+
+    return result;
+}
+
+// The names that may change the globals when a datum calls them or refers
+// to them: the mutating builtins, whose names end in !, the globals of
+// images and every global mentioned in a datum along with one of those, as
+// a mutating procedure or an object to mutate may have been stored there.
+std::unordered_set<std::string_view> FindMutating(
+    const std::vector<const DatumSymbols *> &data,
+    const std::vector<std::string> &opaque) {
+    std::unordered_set<std::string_view> globals{opaque.begin(),
+                                                 opaque.end()};
+    std::unordered_set<std::string_view> mutating{opaque.begin(),
+                                                  opaque.end()};
+
+    for (const auto *datum : data) {
+        globals.insert(datum->assigned.begin(), datum->assigned.end());
+
+        for (auto symbol : datum->symbols) {
+            if (symbol.ends_with('!')) {
+                mutating.insert(symbol);
+            }
+        }
+    }
+
+    std::vector<bool> done(data.size());
+
+    for (bool changed = true; changed;) {
+        changed = false;
+
+        for (size_t i = 0; i != data.size(); ++i) {
+            const auto &symbols = data[i]->symbols;
+
+            if (done[i] || std::none_of(symbols.begin(), symbols.end(),
+                                        [&](std::string_view symbol) {
+                                            return mutating.contains(symbol);
+                                        })) {
+                continue;
+            }
+
+            done[i] = true;
+
+            for (auto symbol : symbols) {
+                if (globals.contains(symbol) &&
+                    mutating.insert(symbol).second) {
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    return mutating;
+}
+
+BatchRunner::Result Evaluate(Interpreter &interpreter, std::string_view datum) {
+    BatchRunner::Result result;
+    result.failed = !interpreter.TryRun(datum, &result.output);
+
+    return result;
+}
+
+} // namespace
+
+struct BatchRunner::Worker {
+    Interpreter interpreter;
+    // data of the current segment not taken yet, the owner takes them from
+    // the front and thieves from the back
+    std::mutex mutex;
+    std::deque<size_t> queue;
+};
+
+struct BatchRunner::Batch {
+    const std::vector<std::string_view> &data;
+    std::vector<Segment> segments;
+    std::vector<Result> results;
+    std::barrier<> barrier;
+};
+
+BatchRunner::BatchRunner(size_t workers) {
+    for (size_t i = 0; i < std::max<size_t>(workers, 1); ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+}
+
+BatchRunner::~BatchRunner() = default;
+
+void BatchRunner::Load(const std::string &path) {
+    // one after another, the first one builds the fasl file for the rest
+    for (auto &worker : workers_) {
+        worker->interpreter.Load(path);
+    }
+
+    MappedFile file{path};
+    Reader reader;
+    reader.Feed(file.GetView());
+    reader.Finish();
+
+    while (auto datum = reader.Next()) {
+        loaded_.emplace_back(*datum);
+    }
+}
+
+void BatchRunner::LoadImage(const std::string &path) {
+    for (auto &worker : workers_) {
+        worker->interpreter.LoadImage(path);
+    }
+
+    for (auto name : workers_.front()->interpreter.GetDefinedGlobals()) {
+        opaque_.emplace_back(SymbolTable::Instance().GetName(name));
+    }
+}
+
+std::vector<BatchRunner::Result> BatchRunner::Run(
+    const std::vector<std::string_view> &data) {
+    Batch batch{data, {}, std::vector<Result>(data.size()),
+                std::barrier<>(static_cast<ptrdiff_t>(workers_.size()))};
+
+    std::vector<DatumSymbols> scanned;
+    std::vector<const DatumSymbols *> all;
+
+    for (const auto &datum : loaded_) {
+        scanned.push_back(ScanDatum(datum));
+    }
+    for (auto datum : data) {
+        scanned.push_back(ScanDatum(datum));
+    }
+    for (const auto &datum : scanned) {
+        all.push_back(&datum);
+    }
+
+    auto mutating = FindMutating(all, opaque_);
+    const auto *symbols = all.data() + all.size() - data.size();
+
+    for (size_t i = 0; i < data.size(); ++i) {
+        const auto &used = symbols[i]->symbols;
+        bool barrier = symbols[i]->definition ||
+                       std::any_of(used.begin(), used.end(),
+                                   [&](std::string_view symbol) {
+                                       return mutating.contains(symbol);
+                                   });
+
+        if (barrier) {
+            batch.segments.push_back({i, i + 1, true});
+        } else if (!batch.segments.empty() && !batch.segments.back().barrier) {
+            batch.segments.back().end = i + 1;
+        } else {
+            batch.segments.push_back({i, i + 1, false});
+        }
+    }
+
+    std::vector<std::thread> threads;
+
+    for (size_t i = 1; i < workers_.size(); ++i) {
+        threads.emplace_back([this, i, &batch] { Work(i, batch); });
+    }
+
+    Work(0, batch);
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    return std::move(batch.results);
+}
+
+size_t BatchRunner::GetWorkerCount() const { return workers_.size(); }
+
+void BatchRunner::Work(size_t index, Batch &batch) {
+    auto &worker = *workers_[index];
+    const size_t count = workers_.size();
+
+    for (const auto &segment : batch.segments) {
+        if (segment.barrier) {
+            auto result =
+                Evaluate(worker.interpreter, batch.data[segment.begin]);
+
+            if (index == 0) {
+                batch.results[segment.begin] = std::move(result);
+            }
+        } else {
+            size_t size = segment.end - segment.begin;
+            size_t first = segment.begin + size * index / count;
+            size_t last = segment.begin + size * (index + 1) / count;
+
+            {
+                std::lock_guard lock{worker.mutex};
+
+                for (size_t i = first; i < last; ++i) {
+                    worker.queue.push_back(i);
+                }
+            }
+
+            while (true) {
+                size_t datum;
+
+                {
+                    std::lock_guard lock{worker.mutex};
+
+                    if (worker.queue.empty()) {
+                        break;
+                    }
+
+                    datum = worker.queue.front();
+                    worker.queue.pop_front();
+                }
+
+                batch.results[datum] =
+                    Evaluate(worker.interpreter, batch.data[datum]);
+            }
+
+            for (size_t datum; Steal(index, &datum);) {
+                batch.results[datum] =
+                    Evaluate(worker.interpreter, batch.data[datum]);
+            }
+        }
+
+        batch.barrier.arrive_and_wait();
+    }
+}
+
+bool BatchRunner::Steal(size_t thief, size_t *datum) {
+    for (size_t i = 1; i < workers_.size(); ++i) {
+        auto &victim = *workers_[(thief + i) % workers_.size()];
+        std::lock_guard lock{victim.mutex};
+
+        if (!victim.queue.empty()) {
+            *datum = victim.queue.back();
+            victim.queue.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
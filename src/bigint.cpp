@@ -0,0 +1,429 @@
+#include "utils/bigint.h"
+#include "utils/error.h"
+
+#include <algorithm>
+#include <bit>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Limbs = std::vector<uint32_t>;
+using Span = std::span<const uint32_t>;
+
+// Below this many limbs in the shorter operand schoolbook multiplication
+// beats Karatsuba.
+constexpr size_t kKaratsubaThreshold = 32;
+
+constexpr uint32_t kDecimalBase = 1000000000;
+constexpr size_t kDecimalDigits = 9;
+
+Span Trim(Span limbs) {
+    while (!limbs.empty() && limbs.back() == 0) {
+        limbs = limbs.first(limbs.size() - 1);
+    }
+
+    return limbs;
+}
+
+void Trim(Limbs *limbs) {
+    while (!limbs->empty() && limbs->back() == 0) {
+        limbs->pop_back();
+    }
+}
+
+std::strong_ordering Compare(Span lhs, Span rhs) {
+    if (lhs.size() != rhs.size()) {
+        return lhs.size() <=> rhs.size();
+    }
+
+    for (size_t i = lhs.size(); i-- != 0;) {
+        if (lhs[i] != rhs[i]) {
+            return lhs[i] <=> rhs[i];
+        }
+    }
+
+    return std::strong_ordering::equal;
+}
+
+Limbs Add(Span lhs, Span rhs) {
+    if (lhs.size() < rhs.size()) {
+        std::swap(lhs, rhs);
+    }
+
+    Limbs sum(lhs.size() + 1);
+    uint64_t carry = 0;
+
+    for (size_t i = 0; i != lhs.size(); ++i) {
+        carry += lhs[i];
+        if (i < rhs.size()) {
+            carry += rhs[i];
+        }
+
+        sum[i] = static_cast<uint32_t>(carry);
+        carry >>= 32;
+    }
+    sum.back() = static_cast<uint32_t>(carry);
+
+    Trim(&sum);
+    return sum;
+}
+
+// lhs -= rhs, lhs has to be the larger one.
+void SubtractFrom(Limbs *lhs, Span rhs) {
+    int64_t borrow = 0;
+
+    for (size_t i = 0; i != lhs->size(); ++i) {
+        if (i >= rhs.size() && borrow == 0) {
+            break;
+        }
+
+        int64_t difference = int64_t{(*lhs)[i]} - borrow -
+                             (i < rhs.size() ? int64_t{rhs[i]} : 0);
+
+        borrow = difference < 0;
+        (*lhs)[i] = static_cast<uint32_t>(difference);
+    }
+
+    Trim(lhs);
+}
+
+// Adds value * 2^(32 * shift) to result, which is long enough for the sum.
+void AddShifted(Limbs *result, Span value, size_t shift) {
+    uint64_t carry = 0;
+    size_t i = 0;
+
+    for (; i != value.size(); ++i) {
+        carry += uint64_t{(*result)[i + shift]} + value[i];
+        (*result)[i + shift] = static_cast<uint32_t>(carry);
+        carry >>= 32;
+    }
+    for (; carry != 0; ++i) {
+        carry += (*result)[i + shift];
+        (*result)[i + shift] = static_cast<uint32_t>(carry);
+        carry >>= 32;
+    }
+}
+
+Limbs MultiplySchoolbook(Span lhs, Span rhs) {
+    Limbs product(lhs.size() + rhs.size());
+
+    for (size_t i = 0; i != lhs.size(); ++i) {
+        uint64_t carry = 0;
+
+        for (size_t j = 0; j != rhs.size(); ++j) {
+            carry += uint64_t{lhs[i]} * rhs[j] + product[i + j];
+            product[i + j] = static_cast<uint32_t>(carry);
+            carry >>= 32;
+        }
+        product[i + rhs.size()] = static_cast<uint32_t>(carry);
+    }
+
+    Trim(&product);
+    return product;
+}
+
+// Karatsuba: with x = x1 B + x0 and y = y1 B + y0, x y is
+// z2 B^2 + ((x0 + x1)(y0 + y1) - z2 - z0) B + z0, three half-size products
+// instead of four.
+Limbs Multiply(Span lhs, Span rhs) {
+    lhs = Trim(lhs);
+    rhs = Trim(rhs);
+
+    if (lhs.size() < rhs.size()) {
+        std::swap(lhs, rhs);
+    }
+    if (rhs.size() < kKaratsubaThreshold) {
+        return MultiplySchoolbook(lhs, rhs);
+    }
+
+    size_t half = lhs.size() / 2;
+    Limbs product(lhs.size() + rhs.size() + 1);
+
+    // too unbalanced to split both: multiply by the halves of lhs
+    if (rhs.size() <= half) {
+        AddShifted(&product, Multiply(lhs.first(half), rhs), 0);
+        AddShifted(&product, Multiply(lhs.subspan(half), rhs), half);
+        Trim(&product);
+        return product;
+    }
+
+    auto lhs_low = lhs.first(half);
+    auto lhs_high = lhs.subspan(half);
+    auto rhs_low = rhs.first(half);
+    auto rhs_high = rhs.subspan(half);
+
+    auto low = Multiply(lhs_low, rhs_low);
+    auto high = Multiply(lhs_high, rhs_high);
+    auto middle = Multiply(Add(Trim(lhs_low), lhs_high),
+                           Add(Trim(rhs_low), rhs_high));
+    SubtractFrom(&middle, low);
+    SubtractFrom(&middle, high);
+
+    AddShifted(&product, low, 0);
+    AddShifted(&product, middle, half);
+    AddShifted(&product, high, 2 * half);
+    Trim(&product);
+    return product;
+}
+
+// Divides in place, returns the remainder.
+uint32_t DivideBySmall(Limbs *limbs, uint32_t divisor) {
+    uint64_t remainder = 0;
+
+    for (size_t i = limbs->size(); i-- != 0;) {
+        uint64_t current = (remainder << 32) | (*limbs)[i];
+        (*limbs)[i] = static_cast<uint32_t>(current / divisor);
+        remainder = current % divisor;
+    }
+
+    Trim(limbs);
+    return static_cast<uint32_t>(remainder);
+}
+
+void MultiplyAddSmall(Limbs *limbs, uint32_t factor, uint32_t addend) {
+    uint64_t carry = addend;
+
+    for (auto &limb : *limbs) {
+        carry += uint64_t{limb} * factor;
+        limb = static_cast<uint32_t>(carry);
+        carry >>= 32;
+    }
+
+    if (carry != 0) {
+        limbs->push_back(static_cast<uint32_t>(carry));
+    }
+}
+
+// Knuth's algorithm D (TAOCP 4.3.1): schoolbook long division estimating
+// every quotient limb from the top limbs of the normalized operands.
+Limbs Divide(Span dividend, Span divisor) {
+    if (Compare(dividend, divisor) < 0) {
+        return {};
+    }
+    if (divisor.size() == 1) {
+        Limbs quotient{dividend.begin(), dividend.end()};
+        DivideBySmall(&quotient, divisor[0]);
+        return quotient;
+    }
+
+    constexpr uint64_t kBase = uint64_t{1} << 32;
+    size_t n = divisor.size();
+    size_t m = dividend.size();
+    int shift = std::countl_zero(divisor.back());
+
+    // shifted so that the top limb of the divisor has its high bit set
+    Limbs v(n);
+    Limbs u(m + 1);
+    for (size_t i = n; i-- != 0;) {
+        uint64_t limb = uint64_t{divisor[i]} << shift;
+        if (i != 0) {
+            limb |= (uint64_t{divisor[i - 1]} << shift) >> 32;
+        }
+        v[i] = static_cast<uint32_t>(limb);
+    }
+    for (size_t i = m + 1; i-- != 0;) {
+        uint64_t limb = i < m ? uint64_t{dividend[i]} << shift : 0;
+        if (i != 0) {
+            limb |= (uint64_t{dividend[i - 1]} << shift) >> 32;
+        }
+        u[i] = static_cast<uint32_t>(limb);
+    }
+
+    Limbs quotient(m - n + 1);
+
+    for (size_t j = m - n + 1; j-- != 0;) {
+        uint64_t top = (uint64_t{u[j + n]} << 32) | u[j + n - 1];
+        uint64_t estimate = top / v[n - 1];
+        uint64_t remainder = top % v[n - 1];
+
+        while (estimate >= kBase ||
+               estimate * v[n - 2] > ((remainder << 32) | u[j + n - 2])) {
+            --estimate;
+            remainder += v[n - 1];
+
+            if (remainder >= kBase) {
+                break;
+            }
+        }
+
+        // u -= estimate * v, shifted by j limbs
+        int64_t borrow = 0;
+        for (size_t i = 0; i != n; ++i) {
+            uint64_t product = estimate * v[i];
+            int64_t difference = int64_t{u[i + j]} - borrow -
+                                 static_cast<int64_t>(product & 0xffffffff);
+
+            u[i + j] = static_cast<uint32_t>(difference);
+            borrow = static_cast<int64_t>(product >> 32) - (difference >> 32);
+        }
+        int64_t difference = int64_t{u[j + n]} - borrow;
+        u[j + n] = static_cast<uint32_t>(difference);
+
+        // the estimate was one too large, add v back
+        if (difference < 0) {
+            --estimate;
+
+            uint64_t carry = 0;
+            for (size_t i = 0; i != n; ++i) {
+                carry += uint64_t{u[i + j]} + v[i];
+                u[i + j] = static_cast<uint32_t>(carry);
+                carry >>= 32;
+            }
+            u[j + n] += static_cast<uint32_t>(carry);
+        }
+
+        quotient[j] = static_cast<uint32_t>(estimate);
+    }
+
+    Trim(&quotient);
+    return quotient;
+}
+
+} // namespace
+
+BigInt::BigInt(int64_t value) : negative_(value < 0) {
+    uint64_t magnitude = static_cast<uint64_t>(value);
+    if (negative_) {
+        magnitude = ~magnitude + 1;
+    }
+
+    for (; magnitude != 0; magnitude >>= 32) {
+        magnitude_.push_back(static_cast<uint32_t>(magnitude));
+    }
+}
+
+BigInt::BigInt(bool negative, Limbs magnitude)
+    : negative_(negative), magnitude_(std::move(magnitude)) {
+    Trim(&magnitude_);
+
+    if (magnitude_.empty()) {
+        negative_ = false;
+    }
+}
+
+BigInt BigInt::Parse(std::string_view str) {
+    bool negative = false;
+
+    if (!str.empty() && (str.front() == '-' || str.front() == '+')) {
+        negative = str.front() == '-';
+        str.remove_prefix(1);
+    }
+    if (str.empty()) {
+        throw SyntaxError{"Invalid constant"};
+    }
+
+    Limbs magnitude;
+
+    // the first chunk takes the digits that don't make up a whole one
+    size_t chunk = (str.size() - 1) % kDecimalDigits + 1;
+    for (size_t i = 0; i != str.size(); i += chunk, chunk = kDecimalDigits) {
+        uint32_t value = 0;
+        uint32_t factor = 1;
+
+        for (char c : str.substr(i, chunk)) {
+            if (c < '0' || c > '9') {
+                throw SyntaxError{"Invalid constant"};
+            }
+
+            value = value * 10 + (c - '0');
+            factor *= 10;
+        }
+
+        MultiplyAddSmall(&magnitude, factor, value);
+    }
+
+    return BigInt{negative, std::move(magnitude)};
+}
+
+std::optional<int64_t> BigInt::ToInt64() const {
+    if (magnitude_.size() > 2) {
+        return std::nullopt;
+    }
+
+    uint64_t magnitude = 0;
+    for (size_t i = magnitude_.size(); i-- != 0;) {
+        magnitude = (magnitude << 32) | magnitude_[i];
+    }
+
+    uint64_t limit = uint64_t{INT64_MAX} + negative_;
+    if (magnitude > limit) {
+        return std::nullopt;
+    }
+
+    return negative_ ? static_cast<int64_t>(~magnitude + 1)
+                     : static_cast<int64_t>(magnitude);
+}
+
+std::string BigInt::ToString() const {
+    if (IsZero()) {
+        return "0";
+    }
+
+    std::vector<uint32_t> chunks;
+    for (Limbs rest = magnitude_; !rest.empty();) {
+        chunks.push_back(DivideBySmall(&rest, kDecimalBase));
+    }
+
+    std::string result = negative_ ? "-" : "";
+    result += std::to_string(chunks.back());
+
+    for (size_t i = chunks.size() - 1; i-- != 0;) {
+        auto digits = std::to_string(chunks[i]);
+        result.append(kDecimalDigits - digits.size(), '0');
+        result += digits;
+    }
+
+    return result;
+}
+
+bool BigInt::IsZero() const { return magnitude_.empty(); }
+
+bool BigInt::IsNegative() const { return negative_; }
+
+BigInt BigInt::operator-() const { return BigInt{!negative_, magnitude_}; }
+
+BigInt operator+(const BigInt &lhs, const BigInt &rhs) {
+    if (lhs.negative_ == rhs.negative_) {
+        return BigInt{lhs.negative_, Add(lhs.magnitude_, rhs.magnitude_)};
+    }
+
+    // the sign is the one of the larger magnitude
+    if (Compare(lhs.magnitude_, rhs.magnitude_) >= 0) {
+        auto magnitude = lhs.magnitude_;
+        SubtractFrom(&magnitude, rhs.magnitude_);
+        return BigInt{lhs.negative_, std::move(magnitude)};
+    }
+
+    auto magnitude = rhs.magnitude_;
+    SubtractFrom(&magnitude, lhs.magnitude_);
+    return BigInt{rhs.negative_, std::move(magnitude)};
+}
+
+BigInt operator-(const BigInt &lhs, const BigInt &rhs) { return lhs + -rhs; }
+
+BigInt operator*(const BigInt &lhs, const BigInt &rhs) {
+    return BigInt{lhs.negative_ != rhs.negative_,
+                  Multiply(lhs.magnitude_, rhs.magnitude_)};
+}
+
+BigInt operator/(const BigInt &lhs, const BigInt &rhs) {
+    return BigInt{lhs.negative_ != rhs.negative_,
+                  Divide(lhs.magnitude_, rhs.magnitude_)};
+}
+
+std::strong_ordering operator<=>(const BigInt &lhs, const BigInt &rhs) {
+    if (lhs.negative_ != rhs.negative_) {
+        return rhs.negative_ <=> lhs.negative_;
+    }
+
+    auto order = Compare(lhs.magnitude_, rhs.magnitude_);
+    return lhs.negative_ ? 0 <=> order : order;
+}
@@ -0,0 +1,79 @@
+#include "utils/bytecode.h"
+#include "utils/base_object.h"
+#include "utils/heap.h"
+
+Code::Code() {
+    bytecode_.reserve(kInitialWords);
+    constants_.reserve(kInitialConstants);
+}
+
+size_t Code::Emit(uint32_t word) {
+    bytecode_.push_back(word);
+    threaded_.clear();
+
+    return bytecode_.size() - 1;
+}
+
+void Code::Patch(size_t position, uint32_t word) {
+    bytecode_[position] = word;
+    threaded_.clear();
+}
+
+void Code::Truncate(size_t size) {
+    bytecode_.resize(size);
+    threaded_.clear();
+}
+
+size_t Code::GetSize() const { return bytecode_.size(); }
+
+size_t Code::GetExternalSize() const {
+    return bytecode_.capacity() * sizeof(uint32_t) +
+           constants_.capacity() * sizeof(Object::NodeType) +
+           threaded_.capacity() * sizeof(uintptr_t);
+}
+
+uint32_t Code::AddConstant(Object::NodeType constant) {
+    constants_.push_back(constant);
+    WriteBarrier(this, constant);
+
+    return constants_.size() - 1;
+}
+
+const std::vector<uint32_t> &Code::GetBytecode() const { return bytecode_; }
+
+const std::vector<Object::NodeType> &Code::GetConstants() const {
+    return constants_;
+}
+
+size_t Code::GetMaxStack() const { return max_stack_; }
+
+void Code::SetMaxStack(size_t size) { max_stack_ = size; }
+
+size_t Code::GetFrameSize() const { return frame_size_; }
+
+void Code::SetFrameSize(size_t size) { frame_size_ = size; }
+
+size_t Code::GetRequired() const { return required_; }
+
+bool Code::HasRest() const { return rest_; }
+
+void Code::SetParameters(size_t required, bool rest) {
+    required_ = required;
+    rest_ = rest;
+}
+
+std::optional<SymbolId> Code::GetName() const { return name_; }
+
+void Code::SetName(SymbolId name) { name_ = name; }
+
+std::vector<uintptr_t> &Code::GetThreaded() { return threaded_; }
+
+const void *Code::GetThreadedTable() const { return threaded_table_; }
+
+void Code::SetThreadedTable(const void *table) { threaded_table_ = table; }
+
+void Code::Trace(Tracer &tracer) {
+    for (auto &constant : constants_) {
+        tracer.Visit(constant);
+    }
+}
@@ -0,0 +1,1186 @@
+#include "utils/compiler.h"
+#include "utils/base_object.h"
+#include "utils/bytecode.h"
+#include "utils/error.h"
+#include "utils/evaluator.h"
+#include "utils/globals.h"
+#include "utils/heap.h"
+#include "utils/object.h"
+#include "utils/symbol_table.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+// Bounds the recursion of the compiler on deeply nested expressions.
+constexpr size_t kMaxNesting = 10000;
+
+// Builtins with a dedicated opcode for the given number of arguments.
+std::optional<Opcode> GetBuiltinOpcode(SymbolId id, size_t argc) {
+    if (argc == 1) {
+        switch (id) {
+        case kCarSymbol:
+            return Opcode::Car;
+        case kCdrSymbol:
+            return Opcode::Cdr;
+        case kNotSymbol:
+            return Opcode::Not;
+        case kNullPredicateSymbol:
+            return Opcode::IsNull;
+        case kPairPredicateSymbol:
+            return Opcode::IsPair;
+        default:
+            return std::nullopt;
+        }
+    }
+
+    if (argc == 2) {
+        switch (id) {
+        case kPlusSymbol:
+            return Opcode::Add;
+        case kMinusSymbol:
+            return Opcode::Subtract;
+        case kMultiplySymbol:
+            return Opcode::Multiply;
+        case kDivideSymbol:
+            return Opcode::Divide;
+        case kEqualSymbol:
+            return Opcode::Equal;
+        case kLessSymbol:
+            return Opcode::Less;
+        case kLessEqualSymbol:
+            return Opcode::LessEqual;
+        case kGreaterSymbol:
+            return Opcode::Greater;
+        case kGreaterEqualSymbol:
+            return Opcode::GreaterEqual;
+        case kConsSymbol:
+            return Opcode::Cons;
+        default:
+            return std::nullopt;
+        }
+    }
+
+    return std::nullopt;
+}
+
+// Builtins without side effects whose result is never a fresh mutable
+// object, so a call with constant arguments can be replaced by its value.
+bool IsFoldable(SymbolId id) {
+    switch (id) {
+    case kPlusSymbol:
+    case kMinusSymbol:
+    case kMultiplySymbol:
+    case kDivideSymbol:
+    case kEqualSymbol:
+    case kLessEqualSymbol:
+    case kGreaterEqualSymbol:
+    case kLessSymbol:
+    case kGreaterSymbol:
+    case kNumberPredicateSymbol:
+    case kBooleanPredicateSymbol:
+    case kPairPredicateSymbol:
+    case kListPredicateSymbol:
+    case kNullPredicateSymbol:
+    case kNotSymbol:
+    case kMinSymbol:
+    case kMaxSymbol:
+    case kCarSymbol:
+    case kCdrSymbol:
+    case kListRefSymbol:
+    case kListTailSymbol:
+    case kAbsSymbol:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool IsKeyword(SymbolId id) {
+    switch (id) {
+    case kQuoteSymbol:
+    case kDefineSymbol:
+    case kLambdaSymbol:
+    case kLetSymbol:
+    case kSetSymbol:
+    case kIfSymbol:
+    case kCondSymbol:
+    case kElseSymbol:
+    case kBeginSymbol:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool IsForm(const Object::NodeType &expression, SymbolId keyword) {
+    auto form = As<Cell>(expression);
+    auto head = form ? As<Symbol>(form->GetFirst()) : nullptr;
+
+    return head && head->GetId() == keyword;
+}
+
+std::vector<Object::NodeType> GetElements(Object::NodeType list,
+                                          const char *error) {
+    std::vector<Object::NodeType> elements;
+
+    for (; Is<Cell>(list); list = As<Cell>(list)->GetSecond()) {
+        elements.push_back(As<Cell>(list)->GetFirst());
+    }
+
+    if (list) {
+        throw SyntaxError{error};
+    }
+
+    return elements;
+}
+
+SymbolId GetName(const Object::NodeType &name, const char *error) {
+    if (auto symbol = As<Symbol>(name); symbol && !IsKeyword(symbol->GetId())) {
+        return symbol->GetId();
+    }
+
+    throw SyntaxError{error};
+}
+
+struct Parameters {
+    std::vector<SymbolId> names;
+    bool rest = false;
+};
+
+// Every name bound by a lambda or a let is bound once.
+void CheckDistinct(const std::vector<SymbolId> &names, const char *message) {
+    for (size_t i = 0; i != names.size(); ++i) {
+        if (std::find(names.begin(), names.begin() + i, names[i]) !=
+            names.begin() + i) {
+            throw SyntaxError{message};
+        }
+    }
+}
+
+// (a b), (a . rest) or a bare symbol taking all the arguments.
+Parameters ParseParameters(Object::NodeType list) {
+    Parameters parameters;
+
+    for (; Is<Cell>(list); list = As<Cell>(list)->GetSecond()) {
+        parameters.names.push_back(
+            GetName(As<Cell>(list)->GetFirst(), "Invalid lambda usage"));
+    }
+
+    if (list) {
+        parameters.names.push_back(GetName(list, "Invalid lambda usage"));
+        parameters.rest = true;
+    }
+
+    CheckDistinct(parameters.names, "Invalid lambda usage");
+
+    return parameters;
+}
+
+// (define name value) or (define (name . parameters) body...)
+struct Definition {
+    Object::NodeType symbol;
+    Object::NodeType value;
+    Object::NodeType parameters;
+    Object::NodeType body;
+    bool is_procedure = false;
+};
+
+Definition ParseDefinition(const Object::NodeType &args) {
+    auto elements = GetElements(args, "Invalid define usage");
+
+    if (elements.size() < 2) {
+        throw SyntaxError{"Invalid define usage"};
+    }
+
+    Definition definition;
+
+    if (auto signature = As<Cell>(elements[0])) {
+        definition.symbol = signature->GetFirst();
+        definition.parameters = signature->GetSecond();
+        definition.body = As<Cell>(args)->GetSecond();
+        definition.is_procedure = true;
+    } else if (elements.size() == 2) {
+        definition.symbol = elements[0];
+        definition.value = elements[1];
+    } else {
+        throw SyntaxError{"Invalid define usage"};
+    }
+
+    GetName(definition.symbol, "Invalid define usage");
+
+    return definition;
+}
+
+// Names assigned with set! anywhere in the expression and names defined at
+// its top level, where they bind globals. Internal defines are locals.
+struct Bindings {
+    std::unordered_set<SymbolId> assigned;
+    std::unordered_set<SymbolId> defined;
+};
+
+void CollectBindings(const Object::NodeType &expression, Bindings *bindings,
+                     size_t nesting = 0, bool toplevel = true) {
+    auto form = As<Cell>(expression);
+
+    // deeper expressions are rejected by the compiler anyway
+    if (!form || IsForm(expression, kQuoteSymbol) || nesting == kMaxNesting) {
+        return;
+    }
+
+    auto target = As<Cell>(form->GetSecond());
+    if (target && IsForm(expression, kSetSymbol)) {
+        if (auto name = As<Symbol>(target->GetFirst())) {
+            bindings->assigned.insert(name->GetId());
+        }
+    }
+    if (toplevel && target && IsForm(expression, kDefineSymbol)) {
+        auto name = target->GetFirst();
+
+        if (auto signature = As<Cell>(name)) {
+            name = signature->GetFirst();
+        }
+        if (auto symbol = As<Symbol>(name)) {
+            bindings->defined.insert(symbol->GetId());
+        }
+    }
+
+    // the forms of a top-level begin are at the top level as well
+    toplevel = toplevel && IsForm(expression, kBeginSymbol);
+
+    for (auto it = expression; Is<Cell>(it); it = As<Cell>(it)->GetSecond()) {
+        CollectBindings(As<Cell>(it)->GetFirst(), bindings, nesting + 1,
+                        toplevel);
+    }
+}
+
+// Expression nodes: atoms, quotations and forms, whose operator is not
+// counted on its own.
+size_t CountNodes(const Object::NodeType &expression) {
+    auto form = As<Cell>(expression);
+
+    if (!form || IsForm(expression, kQuoteSymbol)) {
+        return 1;
+    }
+
+    size_t count = 1;
+    for (auto arg = form->GetSecond(); Is<Cell>(arg);
+         arg = As<Cell>(arg)->GetSecond()) {
+        count += CountNodes(As<Cell>(arg)->GetFirst());
+    }
+
+    return count;
+}
+
+struct Variable {
+    SymbolId name;
+    uint32_t slot;
+    bool boxed;
+};
+
+// Compilation state of a lambda body, or of the query at the outermost
+// level. Slots of the locals are reused once their let ends.
+struct Scope {
+    Scope *parent = nullptr;
+    Code *code = nullptr;
+    std::vector<Variable> locals; // innermost binding last
+    std::vector<Variable> free;   // the slot is the index in the closure
+    uint32_t slots = 0;
+    uint32_t max_slots = 0;
+    size_t depth = 0;
+    size_t max_depth = 0;
+};
+
+enum class Storage { Local, Free, Global };
+
+struct Reference {
+    Storage storage;
+    uint32_t index;
+    bool boxed;
+};
+
+class Compiler {
+  public:
+    Compiler(Globals &globals, const Object::NodeType &expression,
+             Scope *scope, CompileStats *stats)
+        : globals_(globals), scope_(scope), stats_(stats) {
+        CollectBindings(expression, &bindings_);
+    }
+
+    // Top-level definitions, possibly inside begin, bind globals.
+    void CompileToplevel(const Object::NodeType &expression);
+
+    void Finish() {
+        Emit(Opcode::Return);
+        scope_->code->SetFrameSize(scope_->max_slots);
+        scope_->code->SetMaxStack(scope_->max_depth);
+    }
+
+  private:
+    // An expression in tail position is the last thing its procedure
+    // evaluates, calls there reuse the frame of the caller.
+    void CompileExpression(const Object::NodeType &expression,
+                           bool tail = false);
+    void CompileVariable(SymbolId name);
+    void CompileForm(Cell *form, bool tail);
+    void CompileQuote(const Object::NodeType &args);
+    void CompileLogical(const Object::NodeType &args, bool is_and, bool tail);
+    void CompileIf(const Object::NodeType &args, bool tail);
+    void CompileCond(const Object::NodeType &args, bool tail);
+    void CompileSequence(const std::vector<Object::NodeType> &forms,
+                         bool tail);
+    void CompileLet(const Object::NodeType &args, bool tail);
+    void CompileNamedLet(SymbolId name, const Object::NodeType &args,
+                         bool tail);
+    void CompileSet(const Object::NodeType &args);
+    void CompileGlobalDefinition(const Object::NodeType &args);
+    void CompileLambda(const Parameters &parameters,
+                       const Object::NodeType &body,
+                       std::optional<SymbolId> name);
+
+    // Compiles the value of a definition, naming the procedure it makes.
+    void CompileDefinitionValue(const Definition &definition);
+
+    // A lambda or let body: internal definitions come first and are visible
+    // in the whole body, like letrec*.
+    void CompileBody(const Object::NodeType &body, const char *error,
+                     bool tail);
+
+    size_t CompileArguments(Object::NodeType args);
+
+    // The value of an expression made only of constants and calls of
+    // foldable builtins, nullopt when it isn't one or evaluating it fails:
+    // the error is left to be raised when the code runs. Only well-formed
+    // expressions are folded, so syntax errors are still reported.
+    std::optional<Object::NodeType> Fold(const Object::NodeType &expression);
+    std::optional<Object::NodeType> FoldForm(Cell *form);
+
+    // Compiles an expression that is never run, only for its syntax errors,
+    // and drops the code.
+    void CompileDead(const Object::NodeType &expression);
+
+    // Builtins are inlined unless the name is bound by the user.
+    bool IsIntegrated(SymbolId name) const {
+        return GetEvaluator(name) && !globals_.IsDefined(name) &&
+               !bindings_.defined.count(name);
+    }
+
+    Reference Resolve(Scope *scope, SymbolId name);
+
+    // Takes the next free slot. Assigned variables and the ones asked for
+    // are boxed, the box is made by the caller once the slot is set.
+    Variable Declare(SymbolId name, bool boxed = false);
+    void Undeclare(size_t count);
+
+    // A raw reference leaves the box of a boxed variable on the stack.
+    void EmitReference(const Reference &reference, bool raw = false);
+
+    void EmitConstant(const Object::NodeType &value) {
+        Emit(Opcode::Constant, scope_->code->AddConstant(value));
+    }
+
+    void EmitBuiltin(SymbolId id, size_t argc);
+
+    // Emits the instruction, tracking the stack depth it leaves behind, and
+    // returns the position of its first operand for patching.
+    size_t Emit(Opcode opcode, uint32_t operand = 0, uint32_t extra = 0);
+
+    // Points the jump operand at the end of the code emitted so far.
+    void PatchJump(size_t operand) {
+        scope_->code->Patch(operand, scope_->code->GetSize());
+    }
+
+    Globals &globals_;
+    Bindings bindings_;
+    Scope *scope_;
+    CompileStats *stats_;
+    size_t nesting_ = 0;
+    std::unordered_map<Cell *, std::optional<Object::NodeType>> folded_;
+};
+
+void Compiler::CompileToplevel(const Object::NodeType &expression) {
+    if (IsForm(expression, kDefineSymbol)) {
+        CompileGlobalDefinition(As<Cell>(expression)->GetSecond());
+    } else if (IsForm(expression, kBeginSymbol)) {
+        auto forms = GetElements(As<Cell>(expression)->GetSecond(),
+                                 "Invalid begin usage");
+
+        if (forms.empty()) {
+            throw SyntaxError{"Invalid begin usage"};
+        }
+
+        for (size_t i = 0; i != forms.size(); ++i) {
+            if (i != 0) {
+                Emit(Opcode::Pop);
+            }
+            CompileToplevel(forms[i]);
+        }
+    } else {
+        CompileExpression(expression, true);
+    }
+}
+
+void Compiler::CompileExpression(const Object::NodeType &expression,
+                                 bool tail) {
+    if (!expression) {
+        throw RuntimeError{"Null cannot be evaluated"};
+    }
+    if (nesting_ == kMaxNesting) {
+        throw RuntimeError{"Maximum recursion depth exceeded"};
+    }
+    ++nesting_;
+
+    if (auto form = As<Cell>(expression)) {
+        if (auto value = Fold(expression)) {
+            stats_->folded_nodes += CountNodes(expression) - 1;
+            EmitConstant(*value);
+        } else {
+            CompileForm(form, tail);
+        }
+    } else if (auto symbol = As<Symbol>(expression)) {
+        CompileVariable(symbol->GetId());
+    } else if (Is<Reserved>(expression)) {
+        throw SyntaxError{"Reserved symbol cannot be evaluated"};
+    } else {
+        EmitConstant(expression);
+    }
+
+    --nesting_;
+}
+
+void Compiler::CompileVariable(SymbolId name) {
+    auto reference = Resolve(scope_, name);
+
+    if (reference.storage == Storage::Global) {
+        if (IsKeyword(name)) {
+            throw SyntaxError{"Syntactic keyword cannot be evaluated"};
+        }
+        if (IsIntegrated(name)) {
+            EmitConstant(Make<Primitive>(name));
+            return;
+        }
+
+        reference.index = globals_.GetSlot(name);
+    }
+
+    EmitReference(reference);
+}
+
+void Compiler::CompileForm(Cell *form, bool tail) {
+    auto head = form->GetFirst();
+    auto args = form->GetSecond();
+    auto symbol = As<Symbol>(head);
+
+    if (symbol && Resolve(scope_, symbol->GetId()).storage == Storage::Global) {
+        SymbolId id = symbol->GetId();
+
+        switch (id) {
+        case kQuoteSymbol:
+            CompileQuote(args);
+            return;
+        case kAndSymbol:
+        case kOrSymbol:
+            CompileLogical(args, id == kAndSymbol, tail);
+            return;
+        case kIfSymbol:
+            CompileIf(args, tail);
+            return;
+        case kCondSymbol:
+            CompileCond(args, tail);
+            return;
+        case kBeginSymbol: {
+            auto forms = GetElements(args, "Invalid begin usage");
+
+            if (forms.empty()) {
+                throw SyntaxError{"Invalid begin usage"};
+            }
+
+            CompileSequence(forms, tail);
+            return;
+        }
+        case kLetSymbol:
+            CompileLet(args, tail);
+            return;
+        case kSetSymbol:
+            CompileSet(args);
+            return;
+        case kLambdaSymbol: {
+            auto lambda = As<Cell>(args);
+
+            if (!lambda) {
+                throw SyntaxError{"Invalid lambda usage"};
+            }
+
+            CompileLambda(ParseParameters(lambda->GetFirst()),
+                          lambda->GetSecond(), std::nullopt);
+            return;
+        }
+        case kDefineSymbol:
+            // only at the top level or at the start of a body
+            throw SyntaxError{"Invalid define usage"};
+        default:
+            break;
+        }
+
+        // apply calls its procedure, which only the VM can do
+        if (IsIntegrated(id) && id != kApplySymbol) {
+            EmitBuiltin(id, CompileArguments(args));
+            return;
+        }
+    }
+
+    CompileExpression(head);
+    Emit(tail ? Opcode::TailCall : Opcode::Call, CompileArguments(args));
+}
+
+void Compiler::CompileQuote(const Object::NodeType &args) {
+    auto cell = As<Cell>(args);
+
+    if (!cell || cell->GetSecond()) {
+        throw SyntaxError{"Invalid quote usage"};
+    }
+
+    EmitConstant(cell->GetFirst());
+}
+
+// Short-circuits: every argument but the last one jumps to the end with
+// its value when it decides the result. Constants that don't decide it are
+// dropped, one that does ends the expression.
+void Compiler::CompileLogical(const Object::NodeType &args, bool is_and,
+                              bool tail) {
+    auto elements = GetElements(args, "Improper argument list");
+
+    if (elements.empty()) {
+        EmitConstant(Object::NodeType::Boolean(is_and));
+        return;
+    }
+
+    std::vector<size_t> jumps;
+    auto opcode = is_and ? Opcode::JumpIfFalseOrPop : Opcode::JumpIfTrueOrPop;
+
+    for (size_t i = 0; i != elements.size(); ++i) {
+        bool last = i + 1 == elements.size();
+        auto value = last ? std::nullopt : Fold(elements[i]);
+
+        if (value && IsTrue(*value) == is_and) {
+            stats_->folded_nodes += CountNodes(elements[i]);
+            continue;
+        }
+
+        CompileExpression(elements[i], tail && (last || value));
+
+        if (value) {
+            for (size_t k = i + 1; k != elements.size(); ++k) {
+                CompileDead(elements[k]);
+            }
+            break;
+        }
+        if (!last) {
+            jumps.push_back(Emit(opcode));
+        }
+    }
+
+    for (size_t jump : jumps) {
+        PatchJump(jump);
+    }
+}
+
+void Compiler::CompileIf(const Object::NodeType &args, bool tail) {
+    auto parts = GetElements(args, "Invalid if usage");
+
+    if (parts.size() != 2 && parts.size() != 3) {
+        throw SyntaxError{"Invalid if usage"};
+    }
+
+    if (auto test = Fold(parts[0])) {
+        size_t taken = IsTrue(*test) ? 1 : 2;
+
+        stats_->folded_nodes += CountNodes(parts[0]);
+        for (size_t i = 1; i != parts.size(); ++i) {
+            if (i != taken) {
+                CompileDead(parts[i]);
+            }
+        }
+
+        if (taken < parts.size()) {
+            CompileExpression(parts[taken], tail);
+        } else {
+            EmitConstant(nullptr);
+        }
+        return;
+    }
+
+    CompileExpression(parts[0]);
+    size_t to_alternative = Emit(Opcode::JumpIfFalse);
+    size_t depth = scope_->depth;
+
+    CompileExpression(parts[1], tail);
+    size_t to_end = Emit(Opcode::Jump);
+
+    scope_->depth = depth;
+    PatchJump(to_alternative);
+
+    if (parts.size() == 3) {
+        CompileExpression(parts[2], tail);
+    } else {
+        EmitConstant(nullptr);
+    }
+
+    PatchJump(to_end);
+}
+
+// A clause without a body yields the value of its test, no matching clause
+// yields the empty list.
+void Compiler::CompileCond(const Object::NodeType &args, bool tail) {
+    auto clauses = GetElements(args, "Invalid cond usage");
+    std::vector<size_t> to_end;
+    bool has_else = false;
+
+    for (size_t i = 0; i != clauses.size(); ++i) {
+        auto clause = GetElements(clauses[i], "Invalid cond usage");
+        size_t depth = scope_->depth;
+
+        if (clause.empty()) {
+            throw SyntaxError{"Invalid cond usage"};
+        }
+
+        auto test = As<Symbol>(clause[0]);
+        if (test && test->GetId() == kElseSymbol) {
+            if (clause.size() == 1 || i + 1 != clauses.size()) {
+                throw SyntaxError{"Invalid cond usage"};
+            }
+
+            CompileSequence({clause.begin() + 1, clause.end()}, tail);
+            has_else = true;
+            break;
+        }
+
+        CompileExpression(clause[0]);
+
+        if (clause.size() == 1) {
+            to_end.push_back(Emit(Opcode::JumpIfTrueOrPop));
+            continue;
+        }
+
+        size_t to_next = Emit(Opcode::JumpIfFalse);
+        CompileSequence({clause.begin() + 1, clause.end()}, tail);
+        to_end.push_back(Emit(Opcode::Jump));
+
+        scope_->depth = depth;
+        PatchJump(to_next);
+    }
+
+    if (!has_else) {
+        EmitConstant(nullptr);
+    }
+
+    for (size_t jump : to_end) {
+        PatchJump(jump);
+    }
+}
+
+void Compiler::CompileSequence(const std::vector<Object::NodeType> &forms,
+                               bool tail) {
+    for (size_t i = 0; i != forms.size(); ++i) {
+        if (i != 0) {
+            Emit(Opcode::Pop);
+        }
+        CompileExpression(forms[i], tail && i + 1 == forms.size());
+    }
+}
+
+// The values are computed before any of the names is bound.
+void Compiler::CompileLet(const Object::NodeType &args, bool tail) {
+    auto let = As<Cell>(args);
+
+    if (!let) {
+        throw SyntaxError{"Invalid let usage"};
+    }
+    if (auto name = As<Symbol>(let->GetFirst())) {
+        CompileNamedLet(GetName(name, "Invalid let usage"), let->GetSecond(),
+                        tail);
+        return;
+    }
+
+    std::vector<SymbolId> names;
+
+    for (auto &binding : GetElements(let->GetFirst(), "Invalid let usage")) {
+        auto parts = GetElements(binding, "Invalid let usage");
+
+        if (parts.size() != 2) {
+            throw SyntaxError{"Invalid let usage"};
+        }
+
+        SymbolId name = GetName(parts[0], "Invalid let usage");
+        if (std::find(names.begin(), names.end(), name) != names.end()) {
+            throw SyntaxError{"Invalid let usage"};
+        }
+
+        names.push_back(name);
+        CompileExpression(parts[1]);
+    }
+
+    std::vector<Variable> variables;
+    for (SymbolId name : names) {
+        variables.push_back(Declare(name));
+    }
+
+    for (size_t i = variables.size(); i-- != 0;) {
+        Emit(Opcode::LocalSet, variables[i].slot);
+    }
+    for (const auto &variable : variables) {
+        if (variable.boxed) {
+            Emit(Opcode::Box, variable.slot);
+        }
+    }
+
+    CompileBody(let->GetSecond(), "Invalid let usage", tail);
+    Undeclare(variables.size());
+}
+
+// (let loop ((name value) ...) body...) binds loop to the procedure of the
+// body in the body only, and calls it with the values.
+void Compiler::CompileNamedLet(SymbolId name, const Object::NodeType &args,
+                               bool tail) {
+    auto let = As<Cell>(args);
+
+    if (!let) {
+        throw SyntaxError{"Invalid let usage"};
+    }
+
+    Parameters parameters;
+    std::vector<Object::NodeType> values;
+
+    for (auto &binding : GetElements(let->GetFirst(), "Invalid let usage")) {
+        auto parts = GetElements(binding, "Invalid let usage");
+
+        if (parts.size() != 2) {
+            throw SyntaxError{"Invalid let usage"};
+        }
+
+        parameters.names.push_back(GetName(parts[0], "Invalid let usage"));
+        values.push_back(parts[1]);
+    }
+
+    CheckDistinct(parameters.names, "Invalid let usage");
+
+    auto variable = Declare(name, true);
+    EmitConstant(nullptr);
+    Emit(Opcode::LocalSet, variable.slot);
+    Emit(Opcode::Box, variable.slot);
+
+    Reference reference{Storage::Local, variable.slot, true};
+    EmitReference(reference, true);
+    CompileLambda(parameters, let->GetSecond(), name);
+    Emit(Opcode::BoxSet);
+
+    EmitReference(reference);
+
+    // the values don't see the name, no symbol has this id
+    scope_->locals.back().name = std::numeric_limits<SymbolId>::max();
+    for (const auto &value : values) {
+        CompileExpression(value);
+    }
+
+    Emit(tail ? Opcode::TailCall : Opcode::Call, values.size());
+    Undeclare(1);
+}
+
+void Compiler::CompileSet(const Object::NodeType &args) {
+    auto parts = GetElements(args, "Invalid set! usage");
+
+    if (parts.size() != 2) {
+        throw SyntaxError{"Invalid set! usage"};
+    }
+
+    SymbolId name = GetName(parts[0], "Invalid set! usage");
+    auto reference = Resolve(scope_, name);
+
+    if (reference.storage == Storage::Global) {
+        CompileExpression(parts[1]);
+        Emit(Opcode::GlobalSet, globals_.GetSlot(name));
+    } else if (reference.boxed) {
+        EmitReference(reference, true);
+        CompileExpression(parts[1]);
+        Emit(Opcode::BoxSet);
+    } else {
+        CompileExpression(parts[1]);
+        Emit(Opcode::LocalSet, reference.index);
+    }
+
+    EmitConstant(nullptr);
+}
+
+void Compiler::CompileGlobalDefinition(const Object::NodeType &args) {
+    auto definition = ParseDefinition(args);
+    auto name = As<Symbol>(definition.symbol)->GetId();
+
+    CompileDefinitionValue(definition);
+    Emit(Opcode::GlobalDefine, globals_.GetSlot(name));
+    EmitConstant(definition.symbol);
+}
+
+void Compiler::CompileDefinitionValue(const Definition &definition) {
+    auto name = As<Symbol>(definition.symbol)->GetId();
+
+    if (definition.is_procedure) {
+        CompileLambda(ParseParameters(definition.parameters), definition.body,
+                      name);
+        return;
+    }
+
+    auto lambda = As<Cell>(definition.value);
+    if (lambda && IsForm(definition.value, kLambdaSymbol) &&
+        Is<Cell>(lambda->GetSecond()) &&
+        Resolve(scope_, kLambdaSymbol).storage == Storage::Global) {
+        auto args = As<Cell>(lambda->GetSecond());
+        CompileLambda(ParseParameters(args->GetFirst()), args->GetSecond(),
+                      name);
+    } else {
+        CompileExpression(definition.value);
+    }
+}
+
+// The body is compiled into a Code of its own; the values of its free
+// variables, boxes for the assigned ones, are then copied into the closure.
+void Compiler::CompileLambda(const Parameters &parameters,
+                             const Object::NodeType &body,
+                             std::optional<SymbolId> name) {
+    auto code = Make<Code>();
+    Scope scope{
+        .parent = scope_, .code = As<Code>(code), .locals = {}, .free = {}};
+
+    scope.code->SetParameters(parameters.names.size() - parameters.rest,
+                              parameters.rest);
+    if (name) {
+        scope.code->SetName(*name);
+    }
+
+    scope_ = &scope;
+
+    for (SymbolId parameter : parameters.names) {
+        if (auto variable = Declare(parameter); variable.boxed) {
+            Emit(Opcode::Box, variable.slot);
+        }
+    }
+
+    CompileBody(body, "Invalid lambda usage", true);
+    Finish();
+
+    scope_ = scope.parent;
+
+    for (const auto &variable : scope.free) {
+        EmitReference(Resolve(scope_, variable.name), true);
+    }
+
+    Emit(Opcode::MakeClosure, scope_->code->AddConstant(code),
+         scope.free.size());
+}
+
+void Compiler::CompileBody(const Object::NodeType &body, const char *error,
+                           bool tail) {
+    auto forms = GetElements(body, error);
+
+    if (forms.empty()) {
+        throw SyntaxError{error};
+    }
+
+    // boxed, closures defined earlier may capture the later names
+    std::vector<Variable> variables;
+    for (const auto &form : forms) {
+        if (IsForm(form, kDefineSymbol)) {
+            auto definition = ParseDefinition(As<Cell>(form)->GetSecond());
+            auto name = As<Symbol>(definition.symbol)->GetId();
+            auto variable = Declare(name, true);
+
+            EmitConstant(nullptr);
+            Emit(Opcode::LocalSet, variable.slot);
+            Emit(Opcode::Box, variable.slot);
+            variables.push_back(variable);
+        }
+    }
+
+    for (size_t i = 0, defined = 0; i != forms.size(); ++i) {
+        if (i != 0) {
+            Emit(Opcode::Pop);
+        }
+
+        if (!IsForm(forms[i], kDefineSymbol)) {
+            CompileExpression(forms[i], tail && i + 1 == forms.size());
+            continue;
+        }
+
+        auto definition = ParseDefinition(As<Cell>(forms[i])->GetSecond());
+        EmitReference({Storage::Local, variables[defined++].slot, true}, true);
+        CompileDefinitionValue(definition);
+        Emit(Opcode::BoxSet);
+        EmitConstant(definition.symbol);
+    }
+
+    Undeclare(variables.size());
+}
+
+size_t Compiler::CompileArguments(Object::NodeType args) {
+    size_t argc = 0;
+
+    for (; Is<Cell>(args); args = As<Cell>(args)->GetSecond()) {
+        CompileExpression(As<Cell>(args)->GetFirst());
+        ++argc;
+    }
+
+    if (args) {
+        throw SyntaxError{"Improper argument list"};
+    }
+
+    return argc;
+}
+
+std::optional<Object::NodeType>
+Compiler::Fold(const Object::NodeType &expression) {
+    auto form = As<Cell>(expression);
+
+    if (!form) {
+        if (!expression || Is<Symbol>(expression) ||
+            Is<Reserved>(expression)) {
+            return std::nullopt;
+        }
+
+        return expression;
+    }
+
+    if (auto it = folded_.find(form); it != folded_.end()) {
+        return it->second;
+    }
+    if (nesting_ == kMaxNesting) {
+        return std::nullopt;
+    }
+
+    ++nesting_;
+    auto value = FoldForm(form);
+    --nesting_;
+
+    folded_.emplace(form, value);
+    return value;
+}
+
+std::optional<Object::NodeType> Compiler::FoldForm(Cell *form) {
+    auto symbol = As<Symbol>(form->GetFirst());
+
+    if (!symbol ||
+        Resolve(scope_, symbol->GetId()).storage != Storage::Global) {
+        return std::nullopt;
+    }
+
+    std::vector<Object::NodeType> args;
+
+    for (auto arg = form->GetSecond(); arg; arg = As<Cell>(arg)->GetSecond()) {
+        if (!Is<Cell>(arg)) {
+            return std::nullopt;
+        }
+
+        args.push_back(As<Cell>(arg)->GetFirst());
+    }
+
+    SymbolId id = symbol->GetId();
+
+    if (id == kQuoteSymbol) {
+        return args.size() == 1 ? std::optional{args[0]} : std::nullopt;
+    }
+
+    // a branch not taken still has to be foldable, i.e. well-formed
+    if (id == kIfSymbol && (args.size() == 2 || args.size() == 3)) {
+        auto test = Fold(args[0]);
+        auto consequent = Fold(args[1]);
+        auto alternative =
+            args.size() == 3 ? Fold(args[2]) : Object::NodeType{nullptr};
+
+        if (!test || !consequent || !alternative) {
+            return std::nullopt;
+        }
+
+        return IsTrue(*test) ? consequent : alternative;
+    }
+
+    bool is_logical = id == kAndSymbol || id == kOrSymbol;
+    if (!is_logical && (!IsFoldable(id) || !IsIntegrated(id))) {
+        return std::nullopt;
+    }
+
+    for (auto &arg : args) {
+        auto value = Fold(arg);
+
+        if (!value) {
+            return std::nullopt;
+        }
+
+        arg = *value;
+    }
+
+    try {
+        return GetEvaluator(id)->Apply(args);
+    } catch (const RuntimeError &) {
+        return std::nullopt;
+    }
+}
+
+void Compiler::CompileDead(const Object::NodeType &expression) {
+    size_t size = scope_->code->GetSize();
+    size_t depth = scope_->depth;
+
+    CompileExpression(expression);
+    stats_->folded_nodes += CountNodes(expression);
+
+    scope_->code->Truncate(size);
+    scope_->depth = depth;
+}
+
+// A variable found in an enclosing scope becomes a free variable of every
+// scope in between, so each closure captures it from its creator.
+Reference Compiler::Resolve(Scope *scope, SymbolId name) {
+    for (auto it = scope->locals.rbegin(); it != scope->locals.rend(); ++it) {
+        if (it->name == name) {
+            return {Storage::Local, it->slot, it->boxed};
+        }
+    }
+    for (const auto &variable : scope->free) {
+        if (variable.name == name) {
+            return {Storage::Free, variable.slot, variable.boxed};
+        }
+    }
+
+    if (!scope->parent) {
+        return {Storage::Global, 0, false};
+    }
+
+    auto outer = Resolve(scope->parent, name);
+    if (outer.storage == Storage::Global) {
+        return outer;
+    }
+
+    uint32_t index = scope->free.size();
+    scope->free.push_back({name, index, outer.boxed});
+
+    return {Storage::Free, index, outer.boxed};
+}
+
+Variable Compiler::Declare(SymbolId name, bool boxed) {
+    Variable variable{name, scope_->slots++,
+                      boxed || bindings_.assigned.count(name) != 0};
+
+    scope_->locals.push_back(variable);
+    scope_->max_slots = std::max(scope_->max_slots, scope_->slots);
+
+    return variable;
+}
+
+void Compiler::Undeclare(size_t count) {
+    scope_->locals.resize(scope_->locals.size() - count);
+    scope_->slots -= count;
+}
+
+void Compiler::EmitReference(const Reference &reference, bool raw) {
+    switch (reference.storage) {
+    case Storage::Local:
+        Emit(Opcode::LocalRef, reference.index);
+        break;
+    case Storage::Free:
+        Emit(Opcode::FreeRef, reference.index);
+        break;
+    case Storage::Global:
+        Emit(Opcode::GlobalRef, reference.index);
+        break;
+    }
+
+    if (reference.boxed && !raw) {
+        Emit(Opcode::Unbox);
+    }
+}
+
+void Compiler::EmitBuiltin(SymbolId id, size_t argc) {
+    if (auto opcode = GetBuiltinOpcode(id, argc)) {
+        Emit(*opcode);
+    } else {
+        Emit(Opcode::Builtin, id, argc);
+    }
+}
+
+size_t Compiler::Emit(Opcode opcode, uint32_t operand, uint32_t extra) {
+    Code *code = scope_->code;
+    size_t position = code->Emit(static_cast<uint32_t>(opcode));
+    size_t operands = kOperandCount[static_cast<size_t>(opcode)];
+
+    if (operands > 0) {
+        position = code->Emit(operand);
+    }
+    if (operands > 1) {
+        code->Emit(extra);
+    }
+
+    size_t &depth = scope_->depth;
+
+    switch (opcode) {
+    case Opcode::Constant:
+    case Opcode::LocalRef:
+    case Opcode::FreeRef:
+    case Opcode::GlobalRef:
+        ++depth;
+        break;
+    case Opcode::Pop:
+    case Opcode::JumpIfFalse:
+    case Opcode::JumpIfFalseOrPop:
+    case Opcode::JumpIfTrueOrPop:
+    case Opcode::LocalSet:
+    case Opcode::GlobalSet:
+    case Opcode::GlobalDefine:
+    case Opcode::Add:
+    case Opcode::Subtract:
+    case Opcode::Multiply:
+    case Opcode::Divide:
+    case Opcode::Equal:
+    case Opcode::Less:
+    case Opcode::LessEqual:
+    case Opcode::Greater:
+    case Opcode::GreaterEqual:
+    case Opcode::Cons:
+        --depth;
+        break;
+    case Opcode::BoxSet:
+        depth -= 2;
+        break;
+    case Opcode::Call:
+    case Opcode::TailCall:
+        depth -= operand;
+        break;
+    case Opcode::Builtin:
+    case Opcode::MakeClosure:
+        depth = depth - extra + 1;
+        break;
+    default:
+        break;
+    }
+
+    scope_->max_depth = std::max(scope_->max_depth, depth);
+
+    return position;
+}
+
+} // namespace
+
+Object::NodeType Compile(Object::NodeType expression, Globals &globals,
+                         CompileStats *stats) {
+    auto code = Make<Code>();
+    Scope scope{.code = As<Code>(code), .locals = {}, .free = {}};
+    Compiler compiler{globals, expression, &scope, stats};
+
+    compiler.CompileToplevel(expression);
+    compiler.Finish();
+
+    return code;
+}
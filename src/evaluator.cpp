@@ -1,529 +1,616 @@
 #include "utils/evaluator.h"
 #include "utils/base_object.h"
+#include "utils/bigint.h"
 #include "utils/object.h"
+#include "utils/profiler.h"
+#include "utils/reductions.h"
+#include "utils/symbol_table.h"
 #include "utils/tokenizer.h"
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
 #include <string>
-
-EvalCategory DefineCategory(const std::string &symbol) {
-    for (auto &[category, regex] : kEvalCategoriesRegexes) {
-        if (std::regex_match(symbol, regex)) {
-            return category;
-        }
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Op = Arithmetical::ArithmeticalOperations;
+using Predicate = Predicator::PredicateTypes;
+using Compare = Comparator::CompareType;
+using ArrayOp = ArrayFunctor::ArrayFunction;
+using LogicalOp = Logical::LogicalOperation;
+using VectorOp = VectorFunctor::VectorFunction;
+
+const Arithmetical kPlus{Op::Plus};
+const Arithmetical kMinus{Op::Minus};
+const Arithmetical kMultiply{Op::Multiply};
+const Arithmetical kDivide{Op::Divide};
+const Comparator kEqual{Compare::EQ};
+const Comparator kLessEqual{Compare::LE};
+const Comparator kGreaterEqual{Compare::GE};
+const Comparator kLess{Compare::LS};
+const Comparator kGreater{Compare::GR};
+const Predicator kIsNumber{Predicate::Integer};
+const Predicator kIsBoolean{Predicate::Boolean};
+const Predicator kIsPair{Predicate::Pair};
+const Predicator kIsList{Predicate::List};
+const Predicator kIsNull{Predicate::Null};
+const Logical kAnd{LogicalOp::And};
+const Logical kOr{LogicalOp::Or};
+const Logical kNot{LogicalOp::Not};
+const ArrayFunctor kMin{ArrayOp::Min};
+const ArrayFunctor kMax{ArrayOp::Max};
+const ArrayFunctor kCons{ArrayOp::Cons};
+const ArrayFunctor kCar{ArrayOp::Car};
+const ArrayFunctor kCdr{ArrayOp::Cdr};
+const ArrayFunctor kList{ArrayOp::List};
+const ArrayFunctor kListRef{ArrayOp::List_Ref};
+const ArrayFunctor kListTail{ArrayOp::List_Tail};
+const Functor kAbs{Functor::Function::Abs};
+const VectorFunctor kMakeVector{VectorOp::Make};
+const VectorFunctor kVector{VectorOp::Vector};
+const VectorFunctor kVectorRef{VectorOp::Ref};
+const VectorFunctor kVectorSet{VectorOp::Set};
+const VectorFunctor kVectorLength{VectorOp::Length};
+const VectorFunctor kVectorToList{VectorOp::ToList};
+const VectorFunctor kListToVector{VectorOp::FromList};
+const RuntimeStats kRuntimeStats;
+const Applicator kApply;
+
+// 512 MiB of elements, larger requests are surely mistakes.
+constexpr int64_t kMaxVectorSize = 1 << 26;
+
+// Indexed by WellKnownSymbol, order has to follow kWellKnownNames.
+constexpr std::array<const Evaluator *, kWellKnownSymbolCount> kBuiltins{
+    nullptr,     &kPlus,      &kMinus,        &kMultiply, &kDivide,
+    &kEqual,     &kLessEqual, &kGreaterEqual, &kLess,     &kGreater,
+    &kIsNumber,  &kIsBoolean, &kIsPair,       &kIsList,   &kIsNull,
+    &kAnd,       &kOr,        &kNot,          &kMin,      &kMax,
+    &kCons,      &kCar,       &kCdr,          &kList,     &kListRef,
+    &kListTail,  &kAbs,       &kMakeVector,   &kVector,   &kVectorRef,
+    &kVectorSet, &kVectorLength, &kVectorToList, &kListToVector,
+    &kRuntimeStats, &kApply};
+
+void CheckArity(Evaluator::Arguments args, size_t count, const char *name) {
+    if (args.size() != count) {
+        throw RuntimeError{std::string{"Wrong arguments amount for "} + name};
     }
-
-    return EvalCategory::None;
 }
 
-std::unique_ptr<Evaluator> GetEvaluator(const Token &token) {
-    auto p = std::get_if<SymbolToken>(&token);
-    auto quote_p = std::get_if<QuoteToken>(&token);
-
-    if (!p && !quote_p) {
-        throw RuntimeError{"Non-symbol token cannot be evaluated"};
-    }
-
-    std::string symbol;
-    if (p) {
-        symbol = p->name;
-    } else {
-        symbol = "quote";
-    }
-
-    EvalCategory category = DefineCategory(symbol);
-
-    switch (category) {
-    case EvalCategory::Arithmetical:
-        return std::make_unique<Arithmetical>(symbol);
-    case EvalCategory::Predicator:
-        return std::make_unique<Predicator>(
-            symbol.substr(0, symbol.size() - 1));
-    case EvalCategory::Comparator:
-        return std::make_unique<Comparator>(symbol);
-    case EvalCategory::ArrayFunctor:
-        return std::make_unique<ArrayFunctor>(symbol);
-    case EvalCategory::Functor:
-        return std::make_unique<Functor>(symbol);
-    case EvalCategory::Logical:
-        return std::make_unique<Logical>(symbol);
-    case EvalCategory::Quote:
-        return std::make_unique<Quote>();
-    case EvalCategory::None:
-        return nullptr;
+Cell *GetPair(const Object::NodeType &obj) {
+    if (auto cell = As<Cell>(obj)) {
+        return cell;
+    }
+    if (!obj) {
+        throw RuntimeError{"Index out of range"};
     }
 
-    throw RuntimeError{"Unknown function"};
+    throw RuntimeError{"Pair expected"};
 }
 
-Arithmetical::Arithmetical(const std::string &symbol) {
-    if (symbol == "+") {
-        type_ = ArithmeticalOperations::Plus;
-    } else if (symbol == "-") {
-        type_ = ArithmeticalOperations::Minus;
-    } else if (symbol == "*") {
-        type_ = ArithmeticalOperations::Multiply;
-    } else if (symbol == "/") {
-        type_ = ArithmeticalOperations::Divide;
-    } else {
-        throw RuntimeError{"Wrong symbol for arithmetical operator"};
+Vector *GetVector(const Object::NodeType &obj) {
+    if (auto vector = As<Vector>(obj)) {
+        return vector;
     }
-}
 
-Object::NodeType Arithmetical::Evaluate(Object::NodeType args) {
-    int64_t result;
-    std::vector<Object::NodeType> arguments;
-    ToVector(args, arguments);
+    throw RuntimeError{"Vector expected"};
+}
 
-    Object::NodeType number = nullptr;
+size_t GetIndex(const Object::NodeType &obj, size_t size) {
+    int64_t index = GetInteger(obj);
 
-    if (arguments.empty()) {
-        switch (type_) {
-        case ArithmeticalOperations::Minus:
-        case ArithmeticalOperations::Divide:
-            throw RuntimeError{"Invalid arguments for function"};
-        default:
-            break;
-        }
-    } else {
-        number = arguments[0];
-        if (!Is<Number>(number) && Is<Cell>(number)) {
-            number = As<Cell>(number)->Call(nullptr);
-        }
+    if (index < 0 || static_cast<uint64_t>(index) >= size) {
+        throw RuntimeError{"Index out of range"};
     }
 
-    if (!number && args) {
-        throw RuntimeError{"Invalid arguments for function"};
-    }
+    return index;
+}
 
-    switch (type_) {
-    case ArithmeticalOperations::Plus:
-        result = 0;
+// One step on int64_t operands, false when the result is out of range.
+bool ApplySmall(Op type, int64_t *result, int64_t value) {
+    int64_t next = 0;
+    bool overflow = false;
+
+    switch (type) {
+    case Op::Plus:
+        overflow = __builtin_add_overflow(*result, value, &next);
         break;
-    case ArithmeticalOperations::Multiply:
-        result = 1;
+    case Op::Minus:
+        overflow = __builtin_sub_overflow(*result, value, &next);
+        break;
+    case Op::Multiply:
+        overflow = __builtin_mul_overflow(*result, value, &next);
+        break;
+    case Op::Divide:
+        overflow = *result == INT64_MIN && value == -1;
+        next = overflow ? 0 : *result / value;
         break;
-    case ArithmeticalOperations::Minus:
-    case ArithmeticalOperations::Divide:
-        if (!Is<Number>(number)) {
-            throw RuntimeError{"Unexpected token"};
-        }
-
-        result = As<Number>(number)->GetValue();
     }
 
-    for (size_t i = 0; i != arguments.size(); ++i) {
-        if (i == 0 && (type_ == ArithmeticalOperations::Minus ||
-                       type_ == ArithmeticalOperations::Divide)) {
-            continue;
-        }
-
-        if (!arguments[i]) {
-            break;
-        }
-
-        number = arguments[i];
-        if (!Is<Number>(number) && Is<Cell>(number)) {
-            number = As<Cell>(number)->Call(nullptr);
-        }
+    if (!overflow) {
+        *result = next;
+    }
 
-        if (!Is<Number>(number)) {
-            throw RuntimeError{"Unexpected token"};
-        }
+    return !overflow;
+}
 
-        switch (type_) {
-        case ArithmeticalOperations::Plus:
-            result += As<Number>(number)->GetValue();
-            break;
-        case ArithmeticalOperations::Multiply:
-            result *= As<Number>(number)->GetValue();
-            break;
-        case ArithmeticalOperations::Minus:
-            result -= As<Number>(number)->GetValue();
-            break;
-        case ArithmeticalOperations::Divide:
-            result /= As<Number>(number)->GetValue();
-            break;
-        }
+Relation ToRelation(Compare type) {
+    switch (type) {
+    case Compare::EQ:
+        return Relation::Equal;
+    case Compare::LE:
+        return Relation::LessEqual;
+    case Compare::GE:
+        return Relation::GreaterEqual;
+    case Compare::LS:
+        return Relation::Less;
+    case Compare::GR:
+        return Relation::Greater;
     }
 
-    return std::make_shared<Number>(ConstantToken{result});
+    throw RuntimeError{"Not implemented comparison"};
 }
 
-Predicator::Predicator(const std::string &type) {
-    if (type == "number") {
-        type_ = PredicateTypes::Integer;
-    } else if (type == "boolean") {
-        type_ = PredicateTypes::Boolean;
-    } else if (type == "pair") {
-        type_ = PredicateTypes::Pair;
-    } else if (type == "list") {
-        type_ = PredicateTypes::List;
-    } else if (type == "null") {
-        type_ = PredicateTypes::Null;
-    } else {
-        throw RuntimeError{"Wrong symbol for arithmetical operator"};
+BigInt ApplyBig(Op type, const BigInt &lhs, const BigInt &rhs) {
+    switch (type) {
+    case Op::Plus:
+        return lhs + rhs;
+    case Op::Minus:
+        return lhs - rhs;
+    case Op::Multiply:
+        return lhs * rhs;
+    case Op::Divide:
+        return lhs / rhs;
     }
+
+    throw RuntimeError{"Not implemented operation"};
 }
 
-Object::NodeType Predicator::Evaluate(Object::NodeType args) {
-    std::vector<Object::NodeType> arguments;
-    ToVector(args, arguments);
+} // namespace
 
-    if (type_ == PredicateTypes::Integer || type_ == PredicateTypes::Boolean) {
-        bool result = false;
+const Evaluator *GetEvaluator(SymbolId id) {
+    return id < kBuiltins.size() ? kBuiltins[id] : nullptr;
+}
 
-        if (Is<Number>(arguments[0])) {
-            auto num = As<Number>(arguments[0]);
+// Accumulates in an int64_t while no step overflows, in a BigInt after.
+Object::NodeType Arithmetical::Apply(Arguments args) const {
+    int64_t result = 0;
+    std::optional<BigInt> big;
 
-            if (num->IsBoolean()) {
-                result = type_ == PredicateTypes::Boolean;
-            } else {
-                result = type_ == PredicateTypes::Integer;
-            }
+    switch (type_) {
+    case ArithmeticalOperations::Plus:
+        result = 0;
+        break;
+    case ArithmeticalOperations::Multiply:
+        result = 1;
+        break;
+    case ArithmeticalOperations::Minus:
+    case ArithmeticalOperations::Divide:
+        if (args.empty()) {
+            throw RuntimeError{"Invalid arguments for function"};
         }
 
-        return std::make_shared<Number>(BooleanToken{result});
-    } else if (type_ == PredicateTypes::Null) {
-        return std::make_shared<Number>(
-            BooleanToken{As<Cell>(args)->Call(nullptr) == nullptr});
-    } else if (type_ == PredicateTypes::Pair) {
-        if (!Is<Cell>(args)) {
-            return std::make_shared<Number>(BooleanToken{false});
+        // (- x) is the negation and (/ x) the reciprocal of x
+        if (args.size() == 1) {
+            result = type_ == ArithmeticalOperations::Minus ? 0 : 1;
+        } else if (auto number = As<Number>(args[0])) {
+            big = number->GetValue();
+            args = args.subspan(1);
+        } else {
+            result = GetInteger(args[0]);
+            args = args.subspan(1);
         }
+    }
 
-        auto obj = As<Cell>(args)->Call(nullptr);
+    // a long run of fixnums is summed at once, subtracted as a whole
+    if (!big && args.size() >= kMinReduction &&
+        (type_ == ArithmeticalOperations::Plus ||
+         type_ == ArithmeticalOperations::Minus)) {
+        auto sum = SumFixnums(args.data(), args.size());
 
-        if (!obj) {
-            return std::make_shared<Number>(BooleanToken{false});
-        }
-        if (As<Cell>(obj)->GetFirst() && As<Cell>(obj)->GetSecond()) {
-            return std::make_shared<Number>(BooleanToken{true});
+        if (sum && ApplySmall(type_, &result, *sum)) {
+            return MakeInteger(result);
         }
+    }
 
-        return std::make_shared<Number>(BooleanToken{false});
-    } else if (type_ == PredicateTypes::List) {
-        auto obj = As<Cell>(args)->Call(nullptr);
-
-        if (!obj) {
-            return std::make_shared<Number>(BooleanToken{true});
+    for (const auto &arg : args) {
+        // bignums are never zero
+        if (type_ == ArithmeticalOperations::Divide && arg == MakeInteger(0)) {
+            throw RuntimeError{"Division by zero"};
         }
 
-        std::vector<Object::NodeType> arguments;
-        ToVector(obj, arguments);
+        if (!big) {
+            if (arg.IsFixnum() && ApplySmall(type_, &result, arg.GetFixnum())) {
+                continue;
+            }
 
-        if (!arguments[arguments.size() - 1]) {
-            return std::make_shared<Number>(BooleanToken{true});
+            big = BigInt{result};
         }
 
-        return std::make_shared<Number>(BooleanToken{false});
+        *big = ApplyBig(type_, *big, GetBigInteger(arg));
     }
-    throw RuntimeError{"Not implemented predicator"};
+
+    return big ? MakeInteger(std::move(*big)) : MakeInteger(result);
 }
 
-Comparator::Comparator(const std::string &type) {
-    if (type == "=") {
-        type_ = CompareType::EQ;
-    } else if (type == "<=") {
-        type_ = CompareType::LE;
-    } else if (type == ">=") {
-        type_ = CompareType::GE;
-    } else if (type == "<") {
-        type_ = CompareType::LS;
-    } else if (type == ">") {
-        type_ = CompareType::GR;
-    } else {
-        throw RuntimeError{"Wrong symbol for comparison"};
+Object::NodeType Predicator::Apply(Arguments args) const {
+    CheckArity(args, 1, "predicate");
+
+    const auto &arg = args[0];
+
+    switch (type_) {
+    case PredicateTypes::Integer:
+        return Object::NodeType::Boolean(IsInteger(arg));
+    case PredicateTypes::Boolean:
+        return Object::NodeType::Boolean(IsBoolean(arg));
+    case PredicateTypes::Pair:
+        return Object::NodeType::Boolean(Is<Cell>(arg));
+    case PredicateTypes::Null:
+        return Object::NodeType::Boolean(arg == nullptr);
+    case PredicateTypes::List: {
+        auto obj = arg;
+
+        while (Is<Cell>(obj)) {
+            obj = As<Cell>(obj)->GetSecond();
+        }
+
+        return Object::NodeType::Boolean(obj == nullptr);
+    }
     }
-}
 
-Object::NodeType Comparator::Evaluate(Object::NodeType args) {
-    std::vector<Object::NodeType> arguments;
-    ToVector(args, arguments);
+    throw RuntimeError{"Not implemented predicator"};
+}
 
-    if (arguments.empty()) {
-        return std::make_shared<Number>(BooleanToken{true});
+Object::NodeType Comparator::Apply(Arguments args) const {
+    if (args.size() >= kMinReduction) {
+        if (auto result =
+                CompareFixnums(args.data(), args.size(), ToRelation(type_))) {
+            return Object::NodeType::Boolean(*result);
+        }
     }
 
     bool result = true;
 
-    for (size_t i = 1; i != arguments.size(); ++i) {
-        if (!arguments[i]) {
-            break;
+    // every argument is type checked, even after the result is known
+    for (size_t i = 0; i != args.size(); ++i) {
+        if (i == 0 || !result) {
+            GetBigInteger(args[i]);
+            continue;
         }
 
+        auto order = CompareIntegers(args[i - 1], args[i]);
+
         switch (type_) {
         case CompareType::EQ:
-            result &= (As<Number>(arguments[i - 1])->GetValue() ==
-                       As<Number>(arguments[i])->GetValue());
+            result = order == 0;
             break;
         case CompareType::LE:
-            result &= (As<Number>(arguments[i - 1])->GetValue() <=
-                       As<Number>(arguments[i])->GetValue());
+            result = order <= 0;
             break;
         case CompareType::GE:
-            result &= (As<Number>(arguments[i - 1])->GetValue() >=
-                       As<Number>(arguments[i])->GetValue());
+            result = order >= 0;
             break;
         case CompareType::LS:
-            result &= (As<Number>(arguments[i - 1])->GetValue() <
-                       As<Number>(arguments[i])->GetValue());
+            result = order < 0;
             break;
         case CompareType::GR:
-            result &= (As<Number>(arguments[i - 1])->GetValue() >
-                       As<Number>(arguments[i])->GetValue());
-            break;
-        }
-
-        if (!result) {
+            result = order > 0;
             break;
         }
     }
 
-    return std::make_shared<Number>(BooleanToken{result});
-}
-
-ArrayFunctor::ArrayFunctor(const std::string &type) {
-    if (type == "min") {
-        type_ = ArrayFunction::Min;
-    } else if (type == "max") {
-        type_ = ArrayFunction::Max;
-    } else if (type == "cons") {
-        type_ = ArrayFunction::Cons;
-    } else if (type == "car") {
-        type_ = ArrayFunction::Car;
-    } else if (type == "cdr") {
-        type_ = ArrayFunction::Cdr;
-    } else if (type == "list") {
-        type_ = ArrayFunction::List;
-    } else if (type == "list-ref") {
-        type_ = ArrayFunction::List_Ref;
-    } else if (type == "list-tail") {
-        type_ = ArrayFunction::List_Tail;
-    } else {
-        throw RuntimeError{"Wrong symbol for array functor"};
-    }
+    return Object::NodeType::Boolean(result);
 }
 
-Object::NodeType ArrayFunctor::Evaluate(Object::NodeType args) {
-    std::vector<Object::NodeType> arguments;
-    ToVector(args, arguments);
-
-    if (type_ == ArrayFunction::Min || type_ == ArrayFunction::Max) {
-        if (arguments.empty()) {
+Object::NodeType ArrayFunctor::Apply(Arguments args) const {
+    switch (type_) {
+    case ArrayFunction::Min:
+    case ArrayFunction::Max: {
+        if (args.empty()) {
             throw RuntimeError{"Empty array passed"};
         }
 
-        int64_t result = As<Number>(arguments[0])->GetValue();
-        for (size_t i = 1; i != arguments.size(); ++i) {
-            if (!arguments[i]) {
-                break;
-            }
+        if (args.size() >= kMinReduction) {
+            auto result = type_ == ArrayFunction::Min
+                              ? MinFixnum(args.data(), args.size())
+                              : MaxFixnum(args.data(), args.size());
 
-            if (type_ == ArrayFunction::Min) {
-                result = std::min(result, As<Number>(arguments[i])->GetValue());
-            }
-            if (type_ == ArrayFunction::Max) {
-                result = std::max(result, As<Number>(arguments[i])->GetValue());
+            if (result) {
+                return *result;
             }
         }
 
-        return std::make_shared<Number>(ConstantToken{result});
-    } else if (type_ == ArrayFunction::Car) {
-        auto obj = As<Cell>(args)->Call(nullptr);
+        auto result = args[0];
+        GetBigInteger(result);
 
-        if (!obj) {
-            throw RuntimeError{"Index out of range"};
-        }
-
-        std::vector<Object::NodeType> arguments;
-        ToVector(obj, arguments);
+        for (const auto &arg : args.subspan(1)) {
+            auto order = CompareIntegers(arg, result);
 
-        return arguments[0];
-    } else if (type_ == ArrayFunction::Cdr) {
-        auto obj = As<Cell>(args)->Call(nullptr);
-
-        if (!obj) {
-            throw RuntimeError{"Index out of range"};
+            if (type_ == ArrayFunction::Min ? order < 0 : order > 0) {
+                result = arg;
+            }
         }
 
-        std::vector<Object::NodeType> arguments;
-        ToVector(obj, arguments);
-
-        return FromVector(1, arguments);
-    } else if (type_ == ArrayFunction::Cons) {
-        std::vector<Object::NodeType> arguments;
-        ToVector(args, arguments);
-
-        if (arguments.size() != 3) {
+        return result;
+    }
+    case ArrayFunction::Car:
+        CheckArity(args, 1, "car");
+        return GetPair(args[0])->GetFirst();
+    case ArrayFunction::Cdr:
+        CheckArity(args, 1, "cdr");
+        return GetPair(args[0])->GetSecond();
+    case ArrayFunction::Cons: {
+        if (args.size() != 2) {
             throw RuntimeError{"Wrong pair size"};
         }
-        arguments.pop_back();
 
-        return FromVector(0, arguments);
-    } else if (type_ == ArrayFunction::List) {
-        std::vector<Object::NodeType> arguments;
-        if (!args) {
-            arguments.push_back(nullptr);
-        } else {
-            ToVector(args, arguments);
-        }
+        auto cell = Make<Cell>();
+        As<Cell>(cell)->SetFirst(args[0]);
+        As<Cell>(cell)->SetSecond(args[1]);
 
-        return FromVector(0, arguments);
-    } else if (type_ == ArrayFunction::List_Tail ||
-               type_ == ArrayFunction::List_Ref) {
-        std::vector<Object::NodeType> arguments;
-        ToVector(args, arguments);
+        return cell;
+    }
+    case ArrayFunction::List: {
+        Object::NodeType list = nullptr;
 
-        std::vector<Object::NodeType> array;
+        for (size_t i = args.size(); i != 0; --i) {
+            auto cell = Make<Cell>();
+            As<Cell>(cell)->SetFirst(args[i - 1]);
+            As<Cell>(cell)->SetSecond(list);
+            list = cell;
+        }
 
-        if (!Is<Cell>(arguments[0])) {
+        return list;
+    }
+    case ArrayFunction::List_Ref:
+    case ArrayFunction::List_Tail: {
+        if (args.size() != 2) {
+            throw RuntimeError{"Wrong arguments amount for List-Tail, "
+                               "List-Ref"};
+        }
+        if (!Is<Cell>(args[0]) && args[0]) {
             throw RuntimeError{"No array in List-Tail, List-Ref"};
         }
+        if (!IsInteger(args[1])) {
+            throw RuntimeError{"No position in List-Tail, List-Ref"};
+        }
 
-        ToVector(As<Cell>(arguments[0])->Call(nullptr), array);
-        auto pos = As<Number>(arguments[1]);
+        int64_t pos = GetInteger(args[1]);
+        auto list = args[0];
 
-        if (!pos) {
-            throw RuntimeError{"No position in List-Tail, List-Ref"};
+        if (pos < 0) {
+            throw RuntimeError{"Index out of range"};
         }
 
-        if (type_ == ArrayFunction::List_Ref) {
-            if (array.size() <= static_cast<size_t>(pos->GetValue()) + 1) {
+        for (; pos != 0; --pos) {
+            if (!Is<Cell>(list)) {
                 throw RuntimeError{"Index out of range"};
             }
 
-            return array[pos->GetValue()];
-        } else {
-            if (array.size() <= static_cast<size_t>(pos->GetValue())) {
-                throw RuntimeError{"Index out of range"};
-            }
+            list = As<Cell>(list)->GetSecond();
+        }
 
-            return FromVector(pos->GetValue(), array);
+        if (type_ == ArrayFunction::List_Tail) {
+            return list;
         }
+        if (!Is<Cell>(list)) {
+            throw RuntimeError{"Index out of range"};
+        }
+
+        return As<Cell>(list)->GetFirst();
+    }
     }
 
     throw RuntimeError{"Not implemented"};
 }
 
-Functor::Functor(const std::string &type) {
-    if (type == "abs") {
-        type_ = Function::Abs;
-    } else {
-        throw RuntimeError{"Wrong symbol for functor"};
+Object::NodeType VectorFunctor::Apply(Arguments args) const {
+    switch (type_) {
+    case VectorFunction::Make: {
+        if (args.empty() || args.size() > 2) {
+            throw RuntimeError{"Wrong arguments amount for make-vector"};
+        }
+
+        int64_t size = GetInteger(args[0]);
+
+        if (size < 0) {
+            throw RuntimeError{"Negative vector size"};
+        }
+        if (size > kMaxVectorSize) {
+            throw RuntimeError{"Vector size is too large"};
+        }
+
+        auto fill = args.size() == 2 ? args[1] : MakeInteger(0);
+
+        return Make<Vector>(size, fill);
     }
-}
+    case VectorFunction::Vector: {
+        auto obj = Make<Vector>(args.size(), nullptr);
 
-Object::NodeType Functor::Evaluate(Object::NodeType args) {
-    std::vector<Object::NodeType> arguments;
-    ToVector(args, arguments);
+        for (size_t i = 0; i != args.size(); ++i) {
+            As<Vector>(obj)->SetElement(i, args[i]);
+        }
 
-    if (arguments.empty() || arguments.size() > 2 ||
-        !Is<Number>(arguments[0])) {
-        throw RuntimeError{"Wrong arguments amount for abs"};
+        return obj;
     }
+    case VectorFunction::Ref: {
+        CheckArity(args, 2, "vector-ref");
 
-    return std::make_shared<Number>(
-        ConstantToken{std::abs(As<Number>(arguments[0])->GetValue())});
-}
+        auto vector = GetVector(args[0]);
 
-Logical::Logical(const std::string &type) {
-    if (type == "and") {
-        type_ = LogicalOperation::And;
-    } else if (type == "or") {
-        type_ = LogicalOperation::Or;
-    } else if (type == "not") {
-        type_ = LogicalOperation::Not;
-    } else {
-        throw RuntimeError{"Wrong symbol for logical operator"};
+        return vector->GetElement(GetIndex(args[1], vector->GetSize()));
     }
-}
+    case VectorFunction::Set: {
+        CheckArity(args, 3, "vector-set!");
 
-Object::NodeType Logical::Evaluate(Object::NodeType args) {
-    std::vector<Object::NodeType> arguments;
-    ToVector(args, arguments);
+        auto vector = GetVector(args[0]);
+        vector->SetElement(GetIndex(args[1], vector->GetSize()), args[2]);
 
-    if (type_ == LogicalOperation::Not) {
-        if (!args || arguments.empty() || arguments.size() > 2) {
-            throw RuntimeError{"Wrong arguments amount for not"};
+        return nullptr;
+    }
+    case VectorFunction::Length:
+        CheckArity(args, 1, "vector-length");
+        return MakeInteger(GetVector(args[0])->GetSize());
+    case VectorFunction::ToList: {
+        CheckArity(args, 1, "vector->list");
+
+        auto vector = GetVector(args[0]);
+        Object::NodeType list = nullptr;
+
+        for (size_t i = vector->GetSize(); i != 0; --i) {
+            auto cell = Make<Cell>();
+            As<Cell>(cell)->SetFirst(vector->GetElement(i - 1));
+            As<Cell>(cell)->SetSecond(list);
+            list = cell;
         }
 
-        Object::NodeType obj = nullptr;
+        return list;
+    }
+    case VectorFunction::FromList: {
+        CheckArity(args, 1, "list->vector");
 
-        if (Is<Cell>(arguments[0])) {
-            obj = As<Cell>(arguments[0])->Call(nullptr);
-        } else {
-            obj = arguments[0];
+        size_t size = 0;
+        auto list = args[0];
+
+        for (; Is<Cell>(list); list = As<Cell>(list)->GetSecond()) {
+            ++size;
         }
 
-        if (Is<Number>(obj) && As<Number>(obj)->IsBoolean()) {
-            return std::make_shared<Number>(
-                BooleanToken{!As<Number>(obj)->GetBooleanValue()});
+        if (list) {
+            throw RuntimeError{"List expected"};
         }
 
-        return std::make_shared<Number>(BooleanToken{false});
-    }
+        auto obj = Make<Vector>(size, nullptr);
+        list = args[0];
 
-    if (!args) {
-        return std::make_shared<Number>(
-            BooleanToken{type_ == LogicalOperation::And});
+        for (size_t i = 0; i != size; ++i) {
+            As<Vector>(obj)->SetElement(i, As<Cell>(list)->GetFirst());
+            list = As<Cell>(list)->GetSecond();
+        }
+
+        return obj;
+    }
     }
 
-    bool result;
+    throw RuntimeError{"Not implemented"};
+}
 
-    if (type_ == LogicalOperation::And) {
-        result = true;
-    } else if (type_ == LogicalOperation::Or) {
-        result = false;
+Object::NodeType Functor::Apply(Arguments args) const {
+    if (args.size() != 1) {
+        throw RuntimeError{"Wrong arguments amount for abs"};
     }
 
-    for (size_t i = 0; i != arguments.size(); ++i) {
-        bool current_value;
-        Object::NodeType element = nullptr;
-
-        if (Is<Cell>(arguments[i])) {
-            element = As<Cell>(arguments[i])->Call(nullptr);
-        } else {
-            element = arguments[i];
-        }
+    if (auto number = As<Number>(args[0])) {
+        const auto &value = number->GetValue();
+        return value.IsNegative() ? MakeInteger(-value) : args[0];
+    }
 
-        // arguments.clear();
+    // a fixnum and its negation fit into int64_t
+    return MakeInteger(std::abs(GetInteger(args[0])));
+}
 
-        if (element && Is<Number>(element) &&
-            As<Number>(element)->IsBoolean()) {
-            current_value = As<Number>(element)->GetBooleanValue();
-        } else {
-            continue;
+Object::NodeType Logical::Apply(Arguments args) const {
+    switch (type_) {
+    case LogicalOperation::Not:
+        if (args.size() != 1) {
+            throw RuntimeError{"Wrong arguments amount for not"};
         }
 
-        switch (type_) {
-        case LogicalOperation::And:
-            result &= current_value;
-            break;
-        case LogicalOperation::Or:
-            result |= current_value;
-            break;
-        case LogicalOperation::Not:
-            throw RuntimeError{"Unsupported operation"};
+        return Object::NodeType::Boolean(!IsTrue(args[0]));
+    case LogicalOperation::And:
+        for (const auto &arg : args) {
+            if (!IsTrue(arg)) {
+                return arg;
+            }
         }
 
-        if (!result && (type_ == LogicalOperation::And)) {
-            return std::make_shared<Number>(BooleanToken{result});
-        }
-        if (result && (type_ == LogicalOperation::Or)) {
-            return std::make_shared<Number>(BooleanToken{result});
+        return args.empty() ? Object::NodeType::Boolean(true) : args.back();
+    case LogicalOperation::Or:
+        for (const auto &arg : args) {
+            if (IsTrue(arg)) {
+                return arg;
+            }
         }
+
+        return Object::NodeType::Boolean(false);
+    }
+
+    throw RuntimeError{"Unsupported operation"};
+}
+
+Object::NodeType RuntimeStats::Apply(Arguments args) const {
+    if (!args.empty()) {
+        throw RuntimeError{"Wrong arguments amount for runtime-stats"};
+    }
+
+    const auto *profiler = Profiler::Current();
+
+    if (!profiler) {
+        throw RuntimeError{"No running interpreter"};
     }
 
-    if ((result && (type_ == LogicalOperation::And)) ||
-        (!result && (type_ == LogicalOperation::Or))) {
-        if (Is<Cell>(arguments[arguments.size() - 2])) {
-            return As<Cell>(arguments[arguments.size() - 2])->Call(nullptr);
+    Object::NodeType stats = nullptr;
+
+    // the list is built from its end
+    auto push = [&stats](std::string_view name, Object::NodeType value) {
+        auto entry = Make<Cell>();
+        As<Cell>(entry)->SetFirst(Make<Symbol>(
+            Token{SymbolToken{SymbolTable::Instance().Intern(name)}}));
+        As<Cell>(entry)->SetSecond(value);
+
+        auto cell = Make<Cell>();
+        As<Cell>(cell)->SetFirst(entry);
+        As<Cell>(cell)->SetSecond(stats);
+        stats = cell;
+    };
+    auto count = [](uint64_t value) {
+        return MakeInteger(static_cast<int64_t>(value));
+    };
+
+    for (SymbolId id = kWellKnownSymbolCount; id-- != 0;) {
+        if (auto calls = profiler->GetCallCount(id)) {
+            push(kWellKnownNames[id], count(calls));
         }
+    }
+
+    for (size_t phase = Profiler::kPhaseCount; phase-- != 0;) {
+        const auto &histogram =
+            profiler->GetHistogram(static_cast<Profiler::Phase>(phase));
 
-        return arguments[arguments.size() - 2];
+        push(std::string{Profiler::kPhaseNames[phase]} + "-ns",
+             count(histogram.GetSum()));
     }
 
-    return std::make_shared<Number>(BooleanToken{result});
+    push("queries", count(profiler->GetQueryCount()));
+    push("profiling", Object::NodeType::Boolean(profiler->IsEnabled()));
+
+    return stats;
 }
 
-Object::NodeType Quote::Evaluate(Object::NodeType args) { return args; }
\ No newline at end of file
+Object::NodeType Applicator::Apply(Arguments args) const {
+    if (args.size() < 2) {
+        throw RuntimeError{"Wrong arguments amount for apply"};
+    }
+
+    auto primitive = As<Primitive>(args[0]);
+
+    if (!primitive) {
+        throw RuntimeError{"Not callable object"};
+    }
+
+    std::vector<Object::NodeType> spread(args.begin() + 1, args.end() - 1);
+
+    for (auto list = args.back(); list; list = As<Cell>(list)->GetSecond()) {
+        if (!Is<Cell>(list)) {
+            throw RuntimeError{"List expected"};
+        }
+        spread.push_back(As<Cell>(list)->GetFirst());
+    }
+
+    return primitive->GetEvaluator()->Apply(spread);
+}
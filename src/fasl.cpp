@@ -0,0 +1,444 @@
+#include "utils/fasl.h"
+#include "utils/bigint.h"
+#include "utils/error.h"
+#include "utils/object.h"
+#include "utils/symbol_table.h"
+#include "utils/tokenizer.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+// "SCMFASL" and the version of the format.
+constexpr char kMagic[8] = {'S', 'C', 'M', 'F', 'A', 'S', 'L', '2'};
+
+// Numbers are in the byte order of the writer, a reader of the other one
+// sees this mark reversed.
+constexpr uint32_t kByteOrderMark = 0x01020304;
+
+struct Header {
+    char magic[8];
+    uint32_t byte_order;
+    uint32_t datum_count;
+    uint64_t source_hash;
+    uint64_t source_size;
+    // of what follows the header, a damaged file is not decoded
+    uint64_t content_hash;
+    uint32_t symbol_count;
+    uint32_t symbol_size;
+    uint64_t code_size;
+};
+
+enum Op : uint8_t {
+    kNil,
+    kTrue,
+    kFalse,
+    // the zigzag varint of the value follows
+    kFixnum,
+    // the varint length and the decimal digits follow
+    kBignum,
+    // the varint index in the symbol table follows
+    kSymbol,
+    // a varint count n follows, pops n elements and the tail
+    kList,
+    // a varint count n follows, pops n elements
+    kVector,
+    // ends a datum, the stack holds just it
+    kEnd
+};
+
+template <class T>
+void Append(std::string *out, T value) {
+    out->append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// LEB128: 7 bits a byte, the high bit set on all bytes but the last.
+void AppendVarint(std::string *out, uint64_t value) {
+    for (; value >= 0x80; value >>= 7) {
+        *out += static_cast<char>(value | 0x80);
+    }
+
+    *out += static_cast<char>(value);
+}
+
+// Small magnitudes of either sign take few bytes: 0, -1, 1, -2, ...
+uint64_t ZigZag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ (value < 0 ? ~0ull : 0ull);
+}
+
+int64_t UnZigZag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Moves view past the varint, nullopt when it is cut off or too long.
+std::optional<uint64_t> ReadVarint(std::string_view *view) {
+    uint64_t value = 0;
+
+    for (size_t i = 0; i != view->size() && i < 10; ++i) {
+        auto byte = static_cast<uint8_t>((*view)[i]);
+        value |= static_cast<uint64_t>(byte & 0x7f) << (7 * i);
+
+        if (!(byte & 0x80)) {
+            view->remove_prefix(i + 1);
+            return value;
+        }
+    }
+
+    return std::nullopt;
+}
+
+[[noreturn]] void ThrowCorrupt() { throw RuntimeError{"Corrupt fasl file"}; }
+
+} // namespace
+
+uint64_t HashContent(std::string_view content) {
+    // FNV-1a, then the finalizer of MurmurHash3 so that every bit of the
+    // input affects every bit of the hash
+    constexpr uint64_t kPrime = 0x100000001b3;
+    uint64_t hash = 0xcbf29ce484222325;
+
+    for (char byte : content) {
+        hash = (hash ^ static_cast<uint8_t>(byte)) * kPrime;
+    }
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccd;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+bool WriteFileAtomically(const std::string &path, std::string_view content) {
+    auto temporary = path + ".tmp" + std::to_string(getpid());
+    int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                  0644);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    size_t written = 0;
+
+    while (written != content.size()) {
+        ssize_t size =
+            write(fd, content.data() + written, content.size() - written);
+
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size < 0) {
+            break;
+        }
+
+        written += size;
+    }
+
+    bool succeeded = close(fd) == 0 && written == content.size() &&
+                     rename(temporary.c_str(), path.c_str()) == 0;
+
+    if (!succeeded) {
+        unlink(temporary.c_str());
+    }
+
+    return succeeded;
+}
+
+bool FaslWriter::Add(const Value &datum) {
+    size_t size = code_.size();
+
+    Encode(datum);
+
+    if (!valid_) {
+        // the data added before stay
+        code_.resize(size);
+        valid_ = true;
+        return false;
+    }
+
+    code_ += static_cast<char>(kEnd);
+    ++count_;
+
+    return true;
+}
+
+void FaslWriter::Encode(const Value &datum) {
+    // a value to encode, or the op closing a list or a vector
+    struct Task {
+        Value value;
+        Op op;
+        uint32_t count;
+    };
+
+    std::vector<Task> tasks{{datum, kEnd, 0}};
+    std::vector<Value> elements;
+
+    while (!tasks.empty() && valid_) {
+        auto task = tasks.back();
+        tasks.pop_back();
+
+        if (task.op != kEnd) {
+            code_ += static_cast<char>(task.op);
+            AppendVarint(&code_, task.count);
+            continue;
+        }
+
+        const auto &value = task.value;
+
+        if (!value) {
+            code_ += static_cast<char>(kNil);
+        } else if (value.IsBoolean()) {
+            code_ += static_cast<char>(value.GetBoolean() ? kTrue : kFalse);
+        } else if (value.IsFixnum()) {
+            code_ += static_cast<char>(kFixnum);
+            AppendVarint(&code_, ZigZag(value.GetFixnum()));
+        } else if (auto number = As<Number>(value)) {
+            auto digits = number->GetValue().ToString();
+
+            code_ += static_cast<char>(kBignum);
+            AppendVarint(&code_, digits.size());
+            code_ += digits;
+        } else if (auto symbol = As<Symbol>(value)) {
+            code_ += static_cast<char>(kSymbol);
+            AppendVarint(&code_, GetSymbolIndex(symbol->GetId()));
+        } else if (Is<Cell>(value) || Is<Vector>(value)) {
+            // elements are pushed last to first, so they come out in order
+            elements.clear();
+
+            if (auto vector = As<Vector>(value)) {
+                for (size_t i = 0; i != vector->GetSize(); ++i) {
+                    elements.push_back(vector->GetElement(i));
+                }
+
+                tasks.push_back({nullptr, kVector,
+                                 static_cast<uint32_t>(elements.size())});
+            } else {
+                auto tail = value;
+
+                for (; Is<Cell>(tail); tail = As<Cell>(tail)->GetSecond()) {
+                    elements.push_back(As<Cell>(tail)->GetFirst());
+                }
+
+                tasks.push_back({nullptr, kList,
+                                 static_cast<uint32_t>(elements.size())});
+                tasks.push_back({tail, kEnd, 0});
+            }
+
+            valid_ = elements.size() <= UINT32_MAX;
+
+            for (size_t i = elements.size(); i-- != 0;) {
+                tasks.push_back({elements[i], kEnd, 0});
+            }
+        } else {
+            valid_ = false;
+        }
+    }
+}
+
+uint32_t FaslWriter::GetSymbolIndex(SymbolId id) {
+    if (id >= symbol_indices_.size()) {
+        symbol_indices_.resize(id + 1);
+    }
+
+    auto &index = symbol_indices_[id];
+
+    if (index == 0) {
+        symbols_.push_back(id);
+        index = symbols_.size();
+    }
+
+    return index - 1;
+}
+
+std::string FaslWriter::Finish(uint64_t source_hash,
+                               uint64_t source_size) const {
+    // the symbol table and the code
+    std::string content;
+
+    for (auto id : symbols_) {
+        auto name = SymbolTable::Instance().GetName(id);
+
+        AppendVarint(&content, name.size());
+        content += name;
+    }
+
+    size_t symbol_size = content.size();
+    content += code_;
+
+    Header header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.byte_order = kByteOrderMark;
+    header.datum_count = count_;
+    header.source_hash = source_hash;
+    header.source_size = source_size;
+    header.content_hash = HashContent(content);
+    header.symbol_count = symbols_.size();
+    header.symbol_size = symbol_size;
+    header.code_size = code_.size();
+
+    std::string file;
+    file.reserve(sizeof(header) + content.size());
+    Append(&file, header);
+    file += content;
+
+    return file;
+}
+
+std::optional<FaslReader> FaslReader::Open(std::string_view file,
+                                           uint64_t source_hash,
+                                           uint64_t source_size) {
+    Header header;
+
+    if (file.size() < sizeof(header)) {
+        return std::nullopt;
+    }
+
+    std::memcpy(&header, file.data(), sizeof(header));
+    file.remove_prefix(sizeof(header));
+
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.byte_order != kByteOrderMark ||
+        header.source_hash != source_hash ||
+        header.source_size != source_size ||
+        file.size() != header.symbol_size + header.code_size ||
+        HashContent(file) != header.content_hash) {
+        return std::nullopt;
+    }
+
+    FaslReader reader;
+    auto symbols = file.substr(0, header.symbol_size);
+
+    for (uint32_t i = 0; i != header.symbol_count; ++i) {
+        auto size = ReadVarint(&symbols);
+
+        if (!size || symbols.size() < *size) {
+            return std::nullopt;
+        }
+
+        reader.symbols_.push_back(
+            SymbolTable::Instance().Intern(symbols.substr(0, *size)));
+        symbols.remove_prefix(*size);
+    }
+
+    reader.code_ = file.substr(header.symbol_size);
+
+    return reader;
+}
+
+std::optional<Value> FaslReader::Next() {
+    if (position_ == code_.size()) {
+        return std::nullopt;
+    }
+
+    auto read = [this] {
+        auto rest = code_.substr(position_);
+        auto value = ReadVarint(&rest);
+
+        if (!value) {
+            ThrowCorrupt();
+        }
+
+        position_ = code_.size() - rest.size();
+        return *value;
+    };
+    auto pop = [this] {
+        if (stack_.empty()) {
+            ThrowCorrupt();
+        }
+
+        auto value = stack_.back();
+        stack_.pop_back();
+        return value;
+    };
+
+    stack_.clear();
+
+    while (true) {
+        if (position_ == code_.size()) {
+            ThrowCorrupt();
+        }
+
+        auto op = static_cast<uint8_t>(code_[position_++]);
+
+        switch (op) {
+        case kNil:
+            stack_.push_back(nullptr);
+            break;
+        case kTrue:
+        case kFalse:
+            stack_.push_back(Value::Boolean(op == kTrue));
+            break;
+        case kFixnum: {
+            stack_.push_back(MakeInteger(UnZigZag(read())));
+            break;
+        }
+        case kBignum: {
+            auto size = read();
+
+            if (code_.size() - position_ < size) {
+                ThrowCorrupt();
+            }
+
+            stack_.push_back(
+                MakeInteger(BigInt::Parse(code_.substr(position_, size))));
+            position_ += size;
+            break;
+        }
+        case kSymbol: {
+            auto index = read();
+
+            if (index >= symbols_.size()) {
+                ThrowCorrupt();
+            }
+
+            stack_.push_back(Make<Symbol>(Token{SymbolToken{symbols_[index]}}));
+            break;
+        }
+        case kList: {
+            auto count = read();
+            auto list = pop();
+
+            for (uint64_t i = 0; i != count; ++i) {
+                auto cell = Make<Cell>();
+                As<Cell>(cell)->SetFirst(pop());
+                As<Cell>(cell)->SetSecond(list);
+                list = cell;
+            }
+
+            stack_.push_back(list);
+            break;
+        }
+        case kVector: {
+            auto count = read();
+
+            if (stack_.size() < count) {
+                ThrowCorrupt();
+            }
+
+            auto vector = Make<Vector>(count, nullptr);
+
+            for (uint64_t i = count; i-- != 0;) {
+                As<Vector>(vector)->SetElement(i, pop());
+            }
+
+            stack_.push_back(vector);
+            break;
+        }
+        case kEnd:
+            if (stack_.size() != 1) {
+                ThrowCorrupt();
+            }
+
+            return pop();
+        default:
+            ThrowCorrupt();
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#include "utils/globals.h"
+#include "utils/base_object.h"
+#include "utils/heap.h"
+#include "utils/symbol_table.h"
+
+#include <cstdint>
+#include <optional>
+
+Globals::Globals(Heap &heap) : heap_(heap) { heap_.AddRoots(&values_); }
+
+Globals::~Globals() { heap_.RemoveRoots(&values_); }
+
+uint32_t Globals::GetSlot(SymbolId name) {
+    auto [it, inserted] = slots_.try_emplace(name, values_.size());
+
+    if (inserted) {
+        names_.push_back(name);
+        values_.push_back(Object::NodeType::Unbound());
+    }
+
+    return it->second;
+}
+
+std::optional<uint32_t> Globals::FindSlot(SymbolId name) const {
+    auto it = slots_.find(name);
+
+    if (it == slots_.end()) {
+        return std::nullopt;
+    }
+
+    return it->second;
+}
+
+bool Globals::IsDefined(SymbolId name) const {
+    auto slot = FindSlot(name);
+
+    return slot && !values_[*slot].IsUnbound();
+}
+
+SymbolId Globals::GetName(uint32_t slot) const { return names_[slot]; }
+
+uint32_t Globals::GetSlotCount() const { return names_.size(); }
+
+uint64_t Globals::GetVersion() const { return version_; }
+
+void Globals::NoteDefinition() { ++version_; }
+
+Object::NodeType *Globals::GetValues() { return values_.data(); }
@@ -0,0 +1,227 @@
+#include "utils/heap.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+thread_local Heap *current_heap = nullptr;
+
+} // namespace
+
+// Copies nursery objects reachable from the visited slots into the old
+// generation and rewrites the slots to the new addresses.
+class Heap::Evacuator : public Tracer {
+  public:
+    explicit Evacuator(Heap &heap) : heap_(heap) {}
+
+    void Visit(Value &slot) override {
+        Object *object = slot.Get();
+
+        if (!object || object->IsOld()) {
+            return;
+        }
+
+        if (object->header_ & Object::kForwarded) {
+            slot = reinterpret_cast<Object *>(object->header_ &
+                                              ~Object::kForwarded);
+            return;
+        }
+
+        Object *copy = object->Relocate(heap_);
+        object->header_ = reinterpret_cast<uint64_t>(copy) | Object::kForwarded;
+        slot = copy;
+        pending_.push_back(copy);
+    }
+
+    void Drain() {
+        while (!pending_.empty()) {
+            Object *object = pending_.back();
+            pending_.pop_back();
+            object->Trace(*this);
+        }
+    }
+
+  private:
+    Heap &heap_;
+    std::vector<Object *> pending_;
+};
+
+class Heap::Marker : public Tracer {
+  public:
+    void Visit(Value &slot) override {
+        Object *object = slot.Get();
+
+        if (object && !(object->header_ & Object::kMarked)) {
+            object->header_ |= Object::kMarked;
+            pending_.push_back(object);
+        }
+    }
+
+    void Drain() {
+        while (!pending_.empty()) {
+            Object *object = pending_.back();
+            pending_.pop_back();
+            object->Trace(*this);
+        }
+    }
+
+  private:
+    std::vector<Object *> pending_;
+};
+
+Heap::Scope::Scope(Heap *heap)
+    : heap_(heap), previous_(std::exchange(current_heap, heap)) {
+    ++heap_->scope_depth_;
+}
+
+Heap::Scope::~Scope() {
+    current_heap = previous_;
+
+    if (--heap_->scope_depth_ == 0) {
+        heap_->Collect();
+    }
+}
+
+Heap::~Heap() {
+    nursery_.Reset();
+
+    for (auto &old : old_objects_) {
+        delete old.object;
+    }
+}
+
+Heap *Heap::Current() { return current_heap; }
+
+void Heap::AddRoot(Value *root) { roots_.push_back(root); }
+
+void Heap::RemoveRoot(Value *root) {
+    auto it = std::find(roots_.rbegin(), roots_.rend(), root);
+
+    if (it != roots_.rend()) {
+        roots_.erase(std::next(it).base());
+    }
+}
+
+void Heap::AddRoots(std::vector<Value> *roots) {
+    root_vectors_.push_back(roots);
+}
+
+void Heap::RemoveRoots(std::vector<Value> *roots) {
+    auto it = std::find(root_vectors_.begin(), root_vectors_.end(), roots);
+
+    if (it != root_vectors_.end()) {
+        root_vectors_.erase(it);
+    }
+}
+
+void Heap::AddRoots(RootSet *roots) { root_sets_.push_back(roots); }
+
+void Heap::RemoveRoots(RootSet *roots) {
+    auto it = std::find(root_sets_.begin(), root_sets_.end(), roots);
+
+    if (it != root_sets_.end()) {
+        root_sets_.erase(it);
+    }
+}
+
+void Heap::Collect() {
+    auto start = std::chrono::steady_clock::now();
+
+    MinorCollection();
+
+    if (old_bytes_ > major_threshold_) {
+        MajorCollection();
+    }
+
+    uint64_t pause = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+
+    stats_.last_pause_ns = pause;
+    stats_.total_pause_ns += pause;
+    stats_.max_pause_ns = std::max(stats_.max_pause_ns, pause);
+}
+
+void Heap::CollectFull() {
+    MinorCollection();
+    MajorCollection();
+}
+
+Heap::Stats Heap::GetStats() const {
+    Stats stats = stats_;
+
+    stats.nursery_bytes = nursery_.GetStats().bytes + nursery_external_;
+    stats.old_bytes = old_bytes_;
+    stats.old_objects = old_objects_.size();
+
+    return stats;
+}
+
+void Heap::MinorCollection() {
+    size_t old_bytes = old_bytes_;
+    Evacuator evacuator{*this};
+
+    for (Value *root : roots_) {
+        evacuator.Visit(*root);
+    }
+    for (auto *roots : root_vectors_) {
+        for (Value &root : *roots) {
+            evacuator.Visit(root);
+        }
+    }
+    for (auto *roots : root_sets_) {
+        roots->TraceRoots(evacuator);
+    }
+
+    for (Object *holder : remembered_) {
+        holder->header_ &= ~Object::kRemembered;
+        holder->Trace(evacuator);
+    }
+    remembered_.clear();
+
+    evacuator.Drain();
+    nursery_.Reset();
+    nursery_external_ = 0;
+
+    ++stats_.minor_collections;
+    stats_.promoted_bytes += old_bytes_ - old_bytes;
+}
+
+void Heap::MajorCollection() {
+    Marker marker;
+
+    for (Value *root : roots_) {
+        marker.Visit(*root);
+    }
+    for (auto *roots : root_vectors_) {
+        for (Value &root : *roots) {
+            marker.Visit(root);
+        }
+    }
+    for (auto *roots : root_sets_) {
+        roots->TraceRoots(marker);
+    }
+    marker.Drain();
+
+    // objects are freed one by one, their fields are plain words so
+    // nothing recurses
+    size_t live = 0;
+    for (auto &old : old_objects_) {
+        if (old.object->header_ & Object::kMarked) {
+            old.object->header_ &= ~Object::kMarked;
+            old_objects_[live++] = old;
+        } else {
+            old_bytes_ -= old.size;
+            delete old.object;
+        }
+    }
+    old_objects_.resize(live);
+
+    ResetMajorThreshold();
+    ++stats_.major_collections;
+}
+
+void Heap::ResetMajorThreshold() {
+    major_threshold_ = std::max(kMinMajorThreshold, 2 * old_bytes_);
+}
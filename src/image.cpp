@@ -0,0 +1,625 @@
+#include "utils/image.h"
+#include "utils/base_object.h"
+#include "utils/bigint.h"
+#include "utils/bytecode.h"
+#include "utils/error.h"
+#include "utils/evaluator.h"
+#include "utils/fasl.h"
+#include "utils/object.h"
+#include "utils/symbol_table.h"
+#include "utils/tokenizer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// "SCMIMG" and the version of the format.
+constexpr char kMagic[8] = {'S', 'C', 'M', 'I', 'M', 'G', '0', '2'};
+
+// Words are in the byte order of the writer, see fasl.cpp.
+constexpr uint32_t kByteOrderMark = 0x01020304;
+
+// The symbol names follow the header, length-prefixed, and then the words:
+// a slot of every global, its name and its value, and the object records.
+// A record is the ObjectType of the object and its fields.
+struct Header {
+    char magic[8];
+    uint32_t byte_order;
+    uint32_t symbol_count;
+    // of what follows the header, a damaged image is not read
+    uint64_t content_hash;
+    uint64_t symbol_size;
+    uint64_t global_count;
+    uint64_t object_count;
+    uint64_t word_count;
+};
+
+// The tags of Value, which keeps them to itself.
+constexpr uint64_t kFixnumTag = 0x1;
+constexpr uint64_t kFalseWord = 0x2;
+constexpr uint64_t kTrueWord = 0xa;
+constexpr uint64_t kUnboundWord = 0x6;
+constexpr uint64_t kTagMask = 0x7;
+
+[[noreturn]] void ThrowInvalid() { throw RuntimeError{"Invalid image"}; }
+
+// Replaces the operands that depend on the process or on the interpreter:
+// the symbol of Builtin and the slot of a global variable.
+template <class Remap>
+void RemapOperands(std::vector<uint32_t> *bytecode, Remap remap) {
+    for (size_t pc = 0; pc < bytecode->size();) {
+        uint32_t word = (*bytecode)[pc];
+
+        if (word >= kOpcodeCount ||
+            pc + kOperandCount[word] >= bytecode->size()) {
+            ThrowInvalid();
+        }
+
+        auto op = static_cast<Opcode>(word);
+
+        if (op == Opcode::Builtin || op == Opcode::GlobalRef ||
+            op == Opcode::GlobalSet || op == Opcode::GlobalDefine) {
+            (*bytecode)[pc + 1] = remap(op, (*bytecode)[pc + 1]);
+        }
+
+        pc += 1 + kOperandCount[word];
+    }
+}
+
+class ImageWriter {
+  public:
+    std::string Write(Globals &globals);
+
+  private:
+    uint64_t Encode(const Value &value);
+    void EncodeObject(Object *object);
+    void EncodeCode(const Code &code);
+    uint64_t GetSymbolIndex(SymbolId id);
+
+    std::vector<uint64_t> words_;
+    // in the order of their records, found while encoding the earlier ones
+    std::vector<Object *> objects_;
+    std::unordered_map<Object *, uint64_t> indices_;
+    std::vector<SymbolId> symbols_;
+    std::unordered_map<SymbolId, uint64_t> symbol_indices_;
+};
+
+std::string ImageWriter::Write(Globals &globals) {
+    uint32_t global_count = globals.GetSlotCount();
+
+    for (uint32_t slot = 0; slot != global_count; ++slot) {
+        words_.push_back(GetSymbolIndex(globals.GetName(slot)));
+        words_.push_back(Encode(globals.GetValues()[slot]));
+    }
+
+    // a breadth-first walk, records of the objects found are appended
+    for (size_t i = 0; i != objects_.size(); ++i) {
+        EncodeObject(objects_[i]);
+    }
+
+    std::string content;
+
+    for (auto id : symbols_) {
+        auto name = SymbolTable::Instance().GetName(id);
+        auto size = static_cast<uint32_t>(name.size());
+
+        content.append(reinterpret_cast<const char *>(&size), sizeof(size));
+        content += name;
+    }
+
+    size_t symbol_size = content.size();
+    content.append(reinterpret_cast<const char *>(words_.data()),
+                   words_.size() * sizeof(uint64_t));
+
+    Header header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.byte_order = kByteOrderMark;
+    header.symbol_count = symbols_.size();
+    header.content_hash = HashContent(content);
+    header.symbol_size = symbol_size;
+    header.global_count = global_count;
+    header.object_count = objects_.size();
+    header.word_count = words_.size();
+
+    std::string image;
+    image.reserve(sizeof(header) + content.size());
+    image.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    image += content;
+
+    return image;
+}
+
+uint64_t ImageWriter::Encode(const Value &value) {
+    if (value.IsFixnum()) {
+        return (static_cast<uint64_t>(value.GetFixnum()) << 1) | kFixnumTag;
+    }
+    if (value.IsBoolean()) {
+        return value.GetBoolean() ? kTrueWord : kFalseWord;
+    }
+    if (value.IsUnbound()) {
+        return kUnboundWord;
+    }
+    if (!value) {
+        return 0;
+    }
+
+    auto [it, inserted] = indices_.try_emplace(value.Get(), objects_.size());
+
+    if (inserted) {
+        objects_.push_back(value.Get());
+    }
+
+    return (it->second + 1) << 3;
+}
+
+void ImageWriter::EncodeObject(Object *object) {
+    auto type = object->GetObjectType();
+
+    words_.push_back(static_cast<uint64_t>(type));
+
+    switch (type) {
+    case ObjectType::Number: {
+        auto digits = static_cast<Number *>(object)->GetValue().ToString();
+        size_t first = words_.size();
+
+        words_.push_back(digits.size());
+        words_.resize(first + 1 + (digits.size() + 7) / 8);
+        std::memcpy(&words_[first + 1], digits.data(), digits.size());
+        break;
+    }
+    case ObjectType::Symbol:
+        words_.push_back(
+            GetSymbolIndex(static_cast<Symbol *>(object)->GetId()));
+        break;
+    case ObjectType::Cell: {
+        auto cell = static_cast<Cell *>(object);
+
+        words_.push_back(Encode(cell->GetFirst()));
+        words_.push_back(Encode(cell->GetSecond()));
+        break;
+    }
+    case ObjectType::Vector: {
+        auto vector = static_cast<Vector *>(object);
+
+        words_.push_back(vector->GetSize());
+
+        for (size_t i = 0; i != vector->GetSize(); ++i) {
+            words_.push_back(Encode(vector->GetElement(i)));
+        }
+        break;
+    }
+    case ObjectType::Primitive:
+        words_.push_back(
+            GetSymbolIndex(static_cast<Primitive *>(object)->GetId()));
+        break;
+    case ObjectType::Code:
+        EncodeCode(*static_cast<Code *>(object));
+        break;
+    case ObjectType::Closure: {
+        auto closure = static_cast<Closure *>(object);
+
+        words_.push_back(Encode(closure->GetCode()));
+        words_.push_back(closure->GetFreeCount());
+
+        for (size_t i = 0; i != closure->GetFreeCount(); ++i) {
+            words_.push_back(Encode(closure->GetFree(i)));
+        }
+        break;
+    }
+    case ObjectType::Box:
+        words_.push_back(Encode(static_cast<Box *>(object)->Get()));
+        break;
+    default:
+        throw RuntimeError{"Cannot save a malformed datum in an image"};
+    }
+}
+
+void ImageWriter::EncodeCode(const Code &code) {
+    auto name = code.GetName();
+    auto bytecode = code.GetBytecode();
+
+    RemapOperands(&bytecode, [this](Opcode op, uint32_t operand) {
+        // global slots are kept, the globals are written in slot order
+        return op == Opcode::Builtin
+                   ? static_cast<uint32_t>(GetSymbolIndex(operand))
+                   : operand;
+    });
+
+    words_.push_back(code.GetMaxStack());
+    words_.push_back(code.GetFrameSize());
+    words_.push_back(code.GetRequired());
+    words_.push_back(code.HasRest());
+    words_.push_back(name ? GetSymbolIndex(*name) + 1 : 0);
+    words_.push_back(bytecode.size());
+    words_.push_back(code.GetConstants().size());
+    words_.insert(words_.end(), bytecode.begin(), bytecode.end());
+
+    for (const auto &constant : code.GetConstants()) {
+        words_.push_back(Encode(constant));
+    }
+}
+
+uint64_t ImageWriter::GetSymbolIndex(SymbolId id) {
+    auto [it, inserted] = symbol_indices_.try_emplace(id, symbols_.size());
+
+    if (inserted) {
+        symbols_.push_back(id);
+    }
+
+    return it->second;
+}
+
+class ImageReader {
+  public:
+    ImageReader(std::string_view image, Heap &heap, Globals *globals);
+
+    void Read();
+
+  private:
+    uint64_t Next();
+    // Checks that count more words follow.
+    void Expect(uint64_t count) const;
+    Value Decode(uint64_t word) const;
+    SymbolId GetSymbol(uint64_t index) const;
+
+    // The first pass, allocates the objects of the records.
+    void Allocate();
+    Object *AllocateCode();
+    // The second pass, fills the references in.
+    void FixUp();
+
+    std::string_view image_;
+    Heap &heap_;
+    Globals *globals_;
+    Header header_;
+    std::string_view words_;
+    size_t position_ = 0;
+    std::vector<SymbolId> symbols_;
+    // slot in globals_ by slot in the image
+    std::vector<uint32_t> slots_;
+    std::vector<Object *> objects_;
+    std::vector<size_t> offsets_;
+};
+
+ImageReader::ImageReader(std::string_view image, Heap &heap,
+                         Globals *globals)
+    : image_(image), heap_(heap), globals_(globals) {}
+
+void ImageReader::Read() {
+    if (image_.size() < sizeof(header_)) {
+        ThrowInvalid();
+    }
+
+    std::memcpy(&header_, image_.data(), sizeof(header_));
+    auto content = image_.substr(sizeof(header_));
+
+    if (std::memcmp(header_.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header_.byte_order != kByteOrderMark ||
+        header_.symbol_size > content.size() ||
+        (content.size() - header_.symbol_size) / sizeof(uint64_t) !=
+            header_.word_count ||
+        (content.size() - header_.symbol_size) % sizeof(uint64_t) != 0 ||
+        HashContent(content) != header_.content_hash) {
+        ThrowInvalid();
+    }
+
+    auto names = content.substr(0, header_.symbol_size);
+
+    for (uint32_t i = 0; i != header_.symbol_count; ++i) {
+        uint32_t size;
+
+        if (names.size() < sizeof(size)) {
+            ThrowInvalid();
+        }
+
+        std::memcpy(&size, names.data(), sizeof(size));
+        names.remove_prefix(sizeof(size));
+
+        if (names.size() < size) {
+            ThrowInvalid();
+        }
+
+        symbols_.push_back(
+            SymbolTable::Instance().Intern(names.substr(0, size)));
+        names.remove_prefix(size);
+    }
+
+    words_ = content.substr(header_.symbol_size);
+
+    // every record takes a word at least
+    if (header_.global_count > header_.word_count / 2 ||
+        header_.object_count > header_.word_count) {
+        ThrowInvalid();
+    }
+
+    for (uint64_t slot = 0; slot != header_.global_count; ++slot) {
+        slots_.push_back(globals_->GetSlot(GetSymbol(Next())));
+        Next();
+    }
+
+    Allocate();
+    FixUp();
+
+    // the values are set once nothing can fail anymore
+    position_ = 0;
+
+    for (auto slot : slots_) {
+        Next();
+        auto value = Decode(Next());
+
+        if (!value.IsUnbound()) {
+            globals_->GetValues()[slot] = value;
+        }
+    }
+
+    globals_->NoteDefinition();
+}
+
+uint64_t ImageReader::Next() {
+    Expect(1);
+
+    uint64_t word;
+    std::memcpy(&word, words_.data() + position_ * sizeof(word), sizeof(word));
+    ++position_;
+
+    return word;
+}
+
+void ImageReader::Expect(uint64_t count) const {
+    if (header_.word_count - position_ < count) {
+        ThrowInvalid();
+    }
+}
+
+Value ImageReader::Decode(uint64_t word) const {
+    if (word & kFixnumTag) {
+        return Value::Fixnum(static_cast<int64_t>(word) >> 1);
+    }
+
+    switch (word) {
+    case 0:
+        return nullptr;
+    case kFalseWord:
+    case kTrueWord:
+        return Value::Boolean(word == kTrueWord);
+    case kUnboundWord:
+        return Value::Unbound();
+    }
+
+    uint64_t index = (word >> 3) - 1;
+
+    // closures are not allocated yet when the code of one is decoded
+    if ((word & kTagMask) != 0 || index >= objects_.size() ||
+        !objects_[index]) {
+        ThrowInvalid();
+    }
+
+    return objects_[index];
+}
+
+SymbolId ImageReader::GetSymbol(uint64_t index) const {
+    if (index >= symbols_.size()) {
+        ThrowInvalid();
+    }
+
+    return symbols_[index];
+}
+
+void ImageReader::Allocate() {
+    std::vector<size_t> closures;
+
+    objects_.resize(header_.object_count);
+
+    for (auto &object : objects_) {
+        offsets_.push_back(position_);
+
+        switch (static_cast<ObjectType>(Next())) {
+        case ObjectType::Number: {
+            uint64_t size = Next();
+            uint64_t count = size / 8 + (size % 8 != 0);
+
+            Expect(count);
+
+            try {
+                object = heap_.Promote(Number{BigInt::Parse(
+                    words_.substr(position_ * sizeof(uint64_t), size))});
+            } catch (const SyntaxError &) {
+                ThrowInvalid();
+            }
+
+            position_ += count;
+            break;
+        }
+        case ObjectType::Symbol:
+            object = heap_.Promote(
+                Symbol{Token{SymbolToken{GetSymbol(Next())}}});
+            break;
+        case ObjectType::Cell:
+            Expect(2);
+            object = heap_.Promote(Cell{});
+            position_ += 2;
+            break;
+        case ObjectType::Vector: {
+            uint64_t size = Next();
+
+            Expect(size);
+            object = heap_.Promote(Vector{size, nullptr});
+            position_ += size;
+            break;
+        }
+        case ObjectType::Primitive: {
+            auto id = GetSymbol(Next());
+
+            if (!GetEvaluator(id)) {
+                ThrowInvalid();
+            }
+
+            object = heap_.Promote(Primitive{id});
+            break;
+        }
+        case ObjectType::Code:
+            object = AllocateCode();
+            break;
+        case ObjectType::Closure: {
+            // made once the code is there, code never refers to closures
+            closures.push_back(&object - objects_.data());
+            Next();
+            uint64_t size = Next();
+
+            Expect(size);
+            position_ += size;
+            break;
+        }
+        case ObjectType::Box:
+            Expect(1);
+            object = heap_.Promote(Box{nullptr});
+            ++position_;
+            break;
+        default:
+            ThrowInvalid();
+        }
+    }
+
+    for (auto index : closures) {
+        position_ = offsets_[index] + 1;
+
+        auto code = Decode(Next());
+
+        if (!Is<Code>(code)) {
+            ThrowInvalid();
+        }
+
+        objects_[index] = heap_.Promote(Closure{code, Next()});
+    }
+}
+
+Object *ImageReader::AllocateCode() {
+    Code code;
+    uint64_t max_stack = Next();
+    uint64_t frame_size = Next();
+    uint64_t required = Next();
+    bool rest = Next();
+    uint64_t name = Next();
+    uint64_t size = Next();
+    uint64_t constant_count = Next();
+    std::vector<uint32_t> bytecode;
+
+    Expect(size);
+
+    for (uint64_t i = 0; i != size; ++i) {
+        uint64_t word = Next();
+
+        if (word > UINT32_MAX) {
+            ThrowInvalid();
+        }
+
+        bytecode.push_back(word);
+    }
+
+    RemapOperands(&bytecode, [this](Opcode op, uint32_t operand) {
+        if (op == Opcode::Builtin) {
+            return static_cast<uint32_t>(GetSymbol(operand));
+        }
+        if (operand >= slots_.size()) {
+            ThrowInvalid();
+        }
+
+        return slots_[operand];
+    });
+
+    for (auto word : bytecode) {
+        code.Emit(word);
+    }
+
+    code.SetMaxStack(max_stack);
+    code.SetFrameSize(frame_size);
+    code.SetParameters(required, rest);
+
+    if (name != 0) {
+        code.SetName(GetSymbol(name - 1));
+    }
+
+    // added by FixUp
+    Expect(constant_count);
+    position_ += constant_count;
+
+    return heap_.Promote(std::move(code));
+}
+
+void ImageReader::FixUp() {
+    // the records were checked by Allocate
+    for (size_t i = 0; i != objects_.size(); ++i) {
+        auto object = objects_[i];
+        position_ = offsets_[i] + 1;
+
+        switch (object->GetObjectType()) {
+        case ObjectType::Cell: {
+            auto cell = static_cast<Cell *>(object);
+
+            cell->SetFirst(Decode(Next()));
+            cell->SetSecond(Decode(Next()));
+            break;
+        }
+        case ObjectType::Vector: {
+            auto vector = static_cast<Vector *>(object);
+
+            ++position_;
+
+            for (size_t j = 0; j != vector->GetSize(); ++j) {
+                vector->SetElement(j, Decode(Next()));
+            }
+            break;
+        }
+        case ObjectType::Code: {
+            auto code = static_cast<Code *>(object);
+
+            position_ += 5;
+            uint64_t size = Next();
+            uint64_t constant_count = Next();
+            position_ += size;
+
+            for (uint64_t j = 0; j != constant_count; ++j) {
+                code->AddConstant(Decode(Next()));
+            }
+            break;
+        }
+        case ObjectType::Closure: {
+            auto closure = static_cast<Closure *>(object);
+
+            position_ += 2;
+
+            for (size_t j = 0; j != closure->GetFreeCount(); ++j) {
+                closure->SetFree(j, Decode(Next()));
+            }
+            break;
+        }
+        case ObjectType::Box:
+            static_cast<Box *>(object)->Set(Decode(Next()));
+            break;
+        default:
+            // atoms refer to nothing
+            break;
+        }
+    }
+}
+
+} // namespace
+
+std::string WriteImage(Globals &globals) {
+    return ImageWriter{}.Write(globals);
+}
+
+void ReadImage(std::string_view image, Heap &heap, Globals *globals) {
+    // the records point to each other, they are set while no collection
+    // can run, and old objects need the heap to be current
+    Heap::Scope scope{&heap};
+
+    ImageReader{image, heap, globals}.Read();
+
+    // everything restored is reachable from the globals
+    heap.ResetMajorThreshold();
+}
@@ -0,0 +1,47 @@
+#include "utils/mapped_file.h"
+#include "utils/error.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw RuntimeError{"Cannot open file " + path};
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) < 0) {
+        close(fd);
+        throw RuntimeError{"Cannot stat file " + path};
+    }
+
+    size_ = static_cast<size_t>(info.st_size);
+
+    // mmap rejects empty mappings, an empty file is just an empty view
+    if (size_ != 0) {
+        data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (data_ == MAP_FAILED) {
+            data_ = nullptr;
+            close(fd);
+            throw RuntimeError{"Cannot map file " + path};
+        }
+
+        madvise(data_, size_, MADV_SEQUENTIAL);
+    }
+
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        munmap(data_, size_);
+    }
+}
+
+std::string_view MappedFile::GetView() const {
+    return {static_cast<const char *>(data_), size_};
+}
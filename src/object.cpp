@@ -1,196 +1,192 @@
 #include "utils/object.h"
 #include "utils/base_object.h"
+#include "utils/bigint.h"
+#include "utils/bytecode.h"
 #include "utils/error.h"
+#include "utils/printer.h"
 #include "utils/tokenizer.h"
 
+#include <compare>
 #include <cstddef>
-#include <iostream>
 #include <ostream>
 
-// #define DEBUG
+std::ostream &operator<<(std::ostream &out, const Object::NodeType &obj) {
+    Printer printer;
+    printer.Print(obj);
 
-std::ostream &operator<<(std::ostream &out, std::shared_ptr<Object> obj) {
-#ifdef DEBUG
-    if (!obj) {
-        out << "nullptr";
-    }
-#endif
-#ifndef DEBUG
-    if (!obj) {
-        out << "()";
-    }
-#endif
-
-    if (Is<Number>(obj)) {
-#ifdef DEBUG
-        if (As<Number>(obj)->IsBoolean()) {
-            out << "bool{" << As<Number>(obj)->GetBooleanValue() << "}";
-        } else {
-            out << "num{" << As<Number>(obj)->GetValue() << "}";
-        }
-#endif
+    return out << printer.GetView();
+}
 
-#ifndef DEBUG
-        auto num = As<Number>(obj);
+const BigInt &Number::GetValue() const { return value_; }
 
-        if (num->IsBoolean()) {
-            out << (num->GetBooleanValue() ? "#t" : "#f");
-        } else {
-            out << num->GetValue();
-        }
-#endif
+Object::NodeType MakeInteger(int64_t value) {
+    if (Object::NodeType::FitsFixnum(value)) {
+        return Object::NodeType::Fixnum(value);
     }
-    if (Is<Symbol>(obj)) {
-#ifdef DEBUG
-        out << "symb{" << As<Symbol>(obj)->GetName() << "}";
-#endif
-
-#ifndef DEBUG
-        out << As<Symbol>(obj)->GetName();
-#endif
+
+    return Make<Number>(BigInt{value});
+}
+
+Object::NodeType MakeInteger(BigInt value) {
+    auto small = value.ToInt64();
+
+    if (small && Object::NodeType::FitsFixnum(*small)) {
+        return Object::NodeType::Fixnum(*small);
     }
-    if (Is<Cell>(obj)) {
-#ifdef DEBUG
-        out << "cell{" << As<Cell>(obj)->GetFirst() << "; "
-            << As<Cell>(obj)->GetSecond() << "}";
-#endif
 
-#ifndef DEBUG
-        auto first = As<Cell>(obj)->GetFirst();
-        auto second = As<Cell>(obj)->GetSecond();
+    return Make<Number>(std::move(value));
+}
+
+bool IsInteger(const Object::NodeType &obj) {
+    return obj.IsFixnum() || Is<Number>(obj);
+}
 
-        out << first;
+bool IsBoolean(const Object::NodeType &obj) { return obj.IsBoolean(); }
 
-        if (second) {
-            if (Is<Number>(second)) {
-                out << " .";
-            }
+namespace {
 
-            out << " " << second;
-        }
-#endif
-    }
-#ifdef DEBUG
-    if (Is<Null>(obj)) {
-        out << "NULL; ";
+[[noreturn]] void ThrowNotInteger(const Object::NodeType &obj) {
+    if (obj.IsBoolean()) {
+        throw RuntimeError{"Number object doen't hold ConstantToken"};
     }
-#endif
 
-    return out;
+    throw RuntimeError{"Number expected"};
 }
 
-bool Number::IsBoolean() const {
-    return std::get_if<BooleanToken>(&token_) != nullptr;
+} // namespace
+
+int64_t GetInteger(const Object::NodeType &obj) {
+    if (obj.IsFixnum()) {
+        return obj.GetFixnum();
+    }
+    if (auto number = As<Number>(obj)) {
+        if (auto value = number->GetValue().ToInt64()) {
+            return *value;
+        }
+
+        throw RuntimeError{"Integer out of range"};
+    }
+
+    ThrowNotInteger(obj);
 }
 
-int64_t Number::GetValue() const {
-    if (const ConstantToken *p = std::get_if<ConstantToken>(&token_)) {
-        return p->value;
+BigInt GetBigInteger(const Object::NodeType &obj) {
+    if (obj.IsFixnum()) {
+        return BigInt{obj.GetFixnum()};
+    }
+    if (auto number = As<Number>(obj)) {
+        return number->GetValue();
     }
 
-    throw RuntimeError{"Number object doen't hold ConstantToken"};
+    ThrowNotInteger(obj);
 }
 
-bool Number::GetBooleanValue() const {
-    if (const BooleanToken *p = std::get_if<BooleanToken>(&token_)) {
-        return p->value;
+std::strong_ordering CompareIntegers(const Object::NodeType &lhs,
+                                     const Object::NodeType &rhs) {
+    if (lhs.IsFixnum() && rhs.IsFixnum()) {
+        return lhs.GetFixnum() <=> rhs.GetFixnum();
     }
 
-    throw RuntimeError{"Number object doen't hold BooleanToken"};
+    return GetBigInteger(lhs) <=> GetBigInteger(rhs);
 }
 
-Object::NodeType Number::Call(Object::NodeType) {
-    throw RuntimeError{"Number is not callable"};
+bool IsTrue(const Object::NodeType &obj) {
+    return !obj.IsBoolean() || obj.GetBoolean();
 }
 
-const std::string &Symbol::GetName() const {
-    if (const SymbolToken *p = std::get_if<SymbolToken>(&token_)) {
-        return p->name;
+bool GetBoolean(const Object::NodeType &obj) {
+    if (obj.IsBoolean()) {
+        return obj.GetBoolean();
     }
-    if (const QuoteToken *p = std::get_if<QuoteToken>(&token_)) {
-        return p->kName;
+    if (IsInteger(obj)) {
+        throw RuntimeError{"Number object doen't hold BooleanToken"};
     }
 
-    throw RuntimeError{"Symbol object doen't hold SymbolToken"};
+    throw RuntimeError{"Boolean expected"};
 }
 
-bool Symbol::Callable() const { return eval_ != nullptr; }
-
-Object::NodeType Symbol::Call(Object::NodeType args) {
-    if (!eval_) {
-        return shared_from_this();
-    }
+SymbolId Symbol::GetId() const { return id_; }
 
-    return eval_->Evaluate(args);
+std::string_view Symbol::GetName() const {
+    return SymbolTable::Instance().GetName(id_);
 }
 
+const Token &Reserved::GetToken() const { return token_; }
+
 TokenType Reserved::GetType() const { return ::GetType(token_); }
 
-Object::NodeType Reserved::Call(Object::NodeType) {
-    throw SyntaxError{"Reserved symbol cannot be evaluated"};
+void Cell::SetFirst(Object::NodeType other) {
+    left_ = other;
+    WriteBarrier(this, other);
 }
 
-void Cell::SetFirst(Object::NodeType other) { left_ = other; }
-
-void Cell::SetSecond(Object::NodeType other) { right_ = other; }
+void Cell::SetSecond(Object::NodeType other) {
+    right_ = other;
+    WriteBarrier(this, other);
+}
 
 Object::NodeType Cell::GetFirst() const { return left_; }
 
 Object::NodeType Cell::GetSecond() const { return right_; }
 
-Object::NodeType Cell::Call(Object::NodeType) {
-    if (!left_) {
-        throw RuntimeError{"Null is not callable"};
-    }
+void Cell::Trace(Tracer &tracer) {
+    tracer.Visit(left_);
+    tracer.Visit(right_);
+}
 
-    if (Is<Cell>(left_) && Is<Symbol>(As<Cell>(left_)->GetFirst()) &&
-        As<Symbol>(As<Cell>(left_)->GetFirst())->GetName() == "quote" &&
-        right_) {
+size_t Vector::GetSize() const { return elements_.size(); }
 
-        left_ = left_->Call(nullptr);
+size_t Vector::GetExternalSize() const {
+    return elements_.capacity() * sizeof(Object::NodeType);
+}
 
-        if (!left_) {
-            throw RuntimeError{"Not callable object"};
-        }
+Object::NodeType Vector::GetElement(size_t index) const {
+    return elements_[index];
+}
 
-        if (right_) {
-            return left_->Call(right_);
-        }
+void Vector::SetElement(size_t index, Object::NodeType value) {
+    elements_[index] = value;
+    WriteBarrier(this, value);
+}
 
-        return left_;
+void Vector::Trace(Tracer &tracer) {
+    for (auto &element : elements_) {
+        tracer.Visit(element);
     }
+}
+
+SymbolId Primitive::GetId() const { return id_; }
+
+const Evaluator *Primitive::GetEvaluator() const { return eval_; }
 
-    return left_->Call(right_);
+Code *Closure::GetCode() const { return As<Code>(code_); }
+
+size_t Closure::GetFreeCount() const { return free_.size(); }
+
+size_t Closure::GetExternalSize() const {
+    return free_.capacity() * sizeof(Object::NodeType);
 }
 
-void ToVector(Object::NodeType node, std::vector<Object::NodeType> &args) {
-    if (Is<Cell>(node)) {
-        if (Is<Symbol>(As<Cell>(node)->GetFirst()) &&
-            As<Symbol>(As<Cell>(node)->GetFirst())->GetName() == "quote") {
-            args.push_back(node);
-            return;
-        }
+Object::NodeType Closure::GetFree(size_t index) const { return free_[index]; }
 
-        args.push_back(As<Cell>(node)->GetFirst());
+void Closure::SetFree(size_t index, Object::NodeType value) {
+    free_[index] = value;
+    WriteBarrier(this, value);
+}
 
-        if (!As<Cell>(node)->GetSecond()) {
-            args.push_back(nullptr);
-        } else {
-            ToVector(As<Cell>(node)->GetSecond(), args);
-        }
-    } else if (node) {
-        args.push_back(node);
+void Closure::Trace(Tracer &tracer) {
+    tracer.Visit(code_);
+
+    for (auto &value : free_) {
+        tracer.Visit(value);
     }
 }
 
-Object::NodeType FromVector(size_t pos, std::vector<Object::NodeType> &args) {
-    if (pos + 1 == args.size()) {
-        return args[pos];
-    }
+Object::NodeType Box::Get() const { return value_; }
 
-    std::shared_ptr<Cell> obj = std::make_shared<Cell>();
-    obj->SetFirst(args[pos]);
-    obj->SetSecond(FromVector(pos + 1, args));
+void Box::Set(Object::NodeType value) {
+    value_ = value;
+    WriteBarrier(this, value);
+}
 
-    return obj;
-}
\ No newline at end of file
+void Box::Trace(Tracer &tracer) { tracer.Visit(value_); }
@@ -1,41 +1,77 @@
 #include "utils/parser.h"
 #include "utils/base_object.h"
+#include "utils/bigint.h"
 #include "utils/error.h"
 #include "utils/evaluator.h"
 #include "utils/object.h"
+#include "utils/symbol_table.h"
 #include "utils/tokenizer.h"
 
 #include <cstddef>
 #include <iostream>
 #include <memory>
 
+namespace {
+
+// Bounds the recursion of the reader on deeply nested lists, every nested
+// list goes through ReadList.
+constexpr size_t kMaxNesting = 10000;
+
+thread_local size_t nesting = 0;
+
+class NestingGuard {
+  public:
+    NestingGuard() {
+        if (nesting == kMaxNesting) {
+            throw SyntaxError{"Too deeply nested"};
+        }
+        ++nesting;
+    }
+
+    NestingGuard(const NestingGuard &) = delete;
+    NestingGuard &operator=(const NestingGuard &) = delete;
+
+    ~NestingGuard() { --nesting; }
+};
+
+} // namespace
+
 Object::NodeType ConvertNull(Object::NodeType obj) {
     if (Is<Null>(obj)) {
-        obj.reset();
         return nullptr;
     }
 
-    if (Is<Cell>(obj)) {
-        auto left = As<Cell>(obj)->GetFirst();
-        auto right = As<Cell>(obj)->GetSecond();
+    // recurses into the elements only, the tail of a list is walked
+    for (auto cell = As<Cell>(obj); cell;) {
+        auto left = cell->GetFirst();
+        auto right = cell->GetSecond();
 
-        if (left) {
-            As<Cell>(obj)->SetFirst(ConvertNull(left));
-        } else {
+        if (!left || !right) {
             throw SyntaxError{"nullptr in AST"};
         }
 
-        if (right) {
-            As<Cell>(obj)->SetSecond(ConvertNull(right));
-        } else {
-            throw SyntaxError{"nullptr in AST"};
+        cell->SetFirst(ConvertNull(left));
+
+        if (Is<Null>(right)) {
+            cell->SetSecond(nullptr);
         }
+        cell = As<Cell>(right);
     }
 
     return obj;
 }
 
-std::shared_ptr<Object> ReadToken(Tokenizer *tokenizer) {
+// The datum after ', wrapped into a list so that 'x reads as (quote x).
+Object::NodeType ReadQuoted(Tokenizer *tokenizer) {
+    Object::NodeType quoted = Make<Cell>();
+
+    As<Cell>(quoted)->SetFirst(Read(tokenizer, false));
+    As<Cell>(quoted)->SetSecond(Make<Null>()); // turned into () by ConvertNull
+
+    return quoted;
+}
+
+Object::NodeType ReadToken(Tokenizer *tokenizer) {
     if (tokenizer->IsEnd()) {
         throw SyntaxError{"Empty token"};
     }
@@ -45,16 +81,24 @@ std::shared_ptr<Object> ReadToken(Tokenizer *tokenizer) {
 
     switch (GetType(token)) {
     case TokenType::Quote:
-        return std::make_shared<Symbol>(QuoteToken{});
-    case TokenType::Constant:
+        return Make<Symbol>(QuoteToken{});
+    case TokenType::Constant: {
+        const auto &constant = std::get<ConstantToken>(token);
+
+        if (!constant.digits.empty()) {
+            return MakeInteger(BigInt::Parse(constant.digits));
+        }
+
+        return MakeInteger(constant.value);
+    }
     case TokenType::Boolean:
-        return std::make_shared<Number>(token);
+        return Object::NodeType::Boolean(std::get<BooleanToken>(token).value);
     case TokenType::Symbol:
-        return std::make_shared<Symbol>(token);
+        return Make<Symbol>(token);
     case TokenType::OpenBracket:
     case TokenType::CloseBracket:
     case TokenType::Dot:
-        return std::make_shared<Reserved>(token);
+        return Make<Reserved>(token);
     case TokenType::None:
         throw SyntaxError{"None token shouldn't be parsed"};
     }
@@ -62,9 +106,9 @@ std::shared_ptr<Object> ReadToken(Tokenizer *tokenizer) {
     throw SyntaxError{"Unexpected token"};
 }
 
-std::shared_ptr<Object> Read(Tokenizer *tokenizer, bool first) {
+Object::NodeType Read(Tokenizer *tokenizer, bool first) {
     size_t input_counter = 0;
-    std::shared_ptr<Object> root = std::make_shared<Cell>();
+    Object::NodeType root = Make<Cell>();
     auto root_cell = As<Cell>(root);
 
     if (!tokenizer->IsEnd()) {
@@ -109,7 +153,12 @@ std::shared_ptr<Object> Read(Tokenizer *tokenizer, bool first) {
                 throw SyntaxError{"Invalid list instruction"};
             }
 
-            root_cell->SetSecond(Read(tokenizer, false));
+            if (Is<Symbol>(root_cell->GetFirst()) &&
+                As<Symbol>(root_cell->GetFirst())->GetId() == kQuoteSymbol) {
+                root_cell->SetSecond(ReadQuoted(tokenizer));
+            } else {
+                root_cell->SetSecond(Read(tokenizer, false));
+            }
         }
 
         if (!tokenizer->CheckBrackets()) {
@@ -122,7 +171,7 @@ std::shared_ptr<Object> Read(Tokenizer *tokenizer, bool first) {
 
     if (!root_cell->GetSecond()) {
         if (Is<Symbol>(root_cell->GetFirst()) &&
-            As<Symbol>(root_cell->GetFirst())->GetName() == "quote") {
+            As<Symbol>(root_cell->GetFirst())->GetId() == kQuoteSymbol) {
             throw SyntaxError{"Single quote is banned"};
         }
 
@@ -144,66 +193,70 @@ std::shared_ptr<Object> Read(Tokenizer *tokenizer, bool first) {
     return root;
 }
 
-std::shared_ptr<Object> ReadList(Tokenizer *tokenizer) {
-    std::shared_ptr<Cell> node{};
+Object::NodeType ReadList(Tokenizer *tokenizer) {
+    NestingGuard guard;
 
-    auto token = ReadToken(tokenizer);
+    // the elements are appended in a loop, only nested lists recurse
+    Object::NodeType list;
+    Cell *last = nullptr;
+    Object::NodeType tail;
 
-    if (Is<Reserved>(token)) {
-        auto token_type = As<Reserved>(token)->GetType();
+    while (!tail) {
+        // ' prefixes a datum, a quote symbol is an ordinary list element
+        bool quote_prefix = !tokenizer->IsEnd() &&
+                            GetType(tokenizer->GetToken()) == TokenType::Quote;
+        auto token = ReadToken(tokenizer);
+        Object::NodeType element;
 
-        if (token_type == TokenType::OpenBracket) {
-            if (!node) {
-                node = std::make_shared<Cell>();
-                node->SetFirst(ReadList(tokenizer));
+        if (Is<Reserved>(token)) {
+            auto token_type = As<Reserved>(token)->GetType();
+
+            if (token_type == TokenType::OpenBracket) {
+                element = ReadList(tokenizer);
+            } else if (token_type == TokenType::CloseBracket) {
+                tail = Make<Null>(); // NULL -> () empty list
+            } else if (token_type == TokenType::Dot) {
+                tail = Read(tokenizer, false);
+                auto closed_bracket = ReadToken(tokenizer);
+
+                // check if next is number?
+                if (!tail) {
+                    throw SyntaxError{"Incorrect pair usage"};
+                }
+                if (!Is<Reserved>(closed_bracket) ||
+                    As<Reserved>(closed_bracket)->GetType() !=
+                        TokenType::CloseBracket) {
+                    throw SyntaxError{"No closing bracket in the end of pair"};
+                }
+            } else {
+                throw SyntaxError{"ReadList error"};
             }
+        } else if (quote_prefix) {
+            element = Make<Cell>();
 
-            node->SetSecond(ReadList(tokenizer));
-            return node;
-        } else if (token_type == TokenType::CloseBracket) {
-            if (!node) {
-                return std::make_shared<Null>(); // NULL -> () empty list
-            } else if (!node->GetSecond()) {
-                node->SetSecond(nullptr);
-            }
+            As<Cell>(element)->SetFirst(token);
+            As<Cell>(element)->SetSecond(ReadQuoted(tokenizer));
+        } else {
+            element = token;
+        }
 
-            return node;
-        } else if (token_type == TokenType::Dot) {
-            auto second_element = Read(tokenizer, false);
-            auto closed_bracket = ReadToken(tokenizer);
+        if (element) {
+            Object::NodeType node = Make<Cell>();
+            As<Cell>(node)->SetFirst(element);
 
-            // check if next is number?
-            if (!second_element) {
-                throw SyntaxError{"Incorrect pair usage"};
-            }
-            if (!Is<Reserved>(closed_bracket) ||
-                As<Reserved>(closed_bracket)->GetType() !=
-                    TokenType::CloseBracket) {
-                throw SyntaxError{"No closing bracket in the end of pair"};
+            if (last) {
+                last->SetSecond(node);
+            } else {
+                list = node;
             }
-
-            return second_element;
+            last = As<Cell>(node);
         }
-    } else if (Is<Symbol>(token) && As<Symbol>(token)->GetName() == "quote") {
-        std::shared_ptr<Cell> quote_obj = std::make_shared<Cell>();
-
-        quote_obj->SetFirst(token);
-        quote_obj->SetSecond(Read(tokenizer, false));
-
-        node = std::make_shared<Cell>();
-
-        node->SetFirst(quote_obj);
-        node->SetSecond(ReadList(tokenizer));
-
-        return node;
-    } else {
-        node = std::make_shared<Cell>();
-
-        node->SetFirst(token);
-        node->SetSecond(ReadList(tokenizer));
+    }
 
-        return node;
+    if (!last) {
+        return tail;
     }
 
-    throw SyntaxError{"ReadList error"};
+    last->SetSecond(tail);
+    return list;
 }
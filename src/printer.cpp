@@ -0,0 +1,167 @@
+#include "utils/printer.h"
+#include "utils/bytecode.h"
+#include "utils/error.h"
+#include "utils/object.h"
+#include "utils/symbol_table.h"
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+
+#include <unistd.h>
+
+Printer::Printer(int fd) : fd_(fd) {}
+
+Printer::~Printer() {
+    try {
+        Flush();
+    } catch (const RuntimeError &) {
+    }
+}
+
+void Printer::Print(const Value &value) {
+    using Kind = Task::Kind;
+
+    // left over when a flush failed
+    tasks_.clear();
+    Enter(value);
+
+    while (!tasks_.empty()) {
+        // Enter may grow the stack, the task is updated before
+        auto &task = tasks_.back();
+
+        switch (task.kind) {
+        case Kind::ListTail:
+            if (!task.value) {
+                buffer_ += ')';
+                tasks_.pop_back();
+            } else if (auto cell = As<Cell>(task.value)) {
+                buffer_ += ' ';
+                task.value = cell->GetSecond();
+                Enter(cell->GetFirst());
+            } else {
+                auto rest = task.value;
+
+                buffer_ += " . ";
+                task.kind = Kind::Close;
+                Enter(rest);
+            }
+            break;
+        case Kind::VectorTail: {
+            auto vector = As<Vector>(task.value);
+            size_t index = task.index++;
+
+            if (index == vector->GetSize()) {
+                buffer_ += ')';
+                tasks_.pop_back();
+                break;
+            }
+            if (index != 0) {
+                buffer_ += ' ';
+            }
+
+            Enter(vector->GetElement(index));
+            break;
+        }
+        case Kind::Close:
+            buffer_ += ')';
+            tasks_.pop_back();
+            break;
+        }
+
+        FlushIfFull();
+    }
+}
+
+void Printer::Enter(Value value) {
+    using Kind = Task::Kind;
+
+    // down the first elements of nested lists at once
+    while (auto cell = As<Cell>(value)) {
+        buffer_ += '(';
+        tasks_.push_back({Kind::ListTail, cell->GetSecond()});
+        value = cell->GetFirst();
+    }
+
+    if (Is<Vector>(value)) {
+        buffer_ += "#(";
+        tasks_.push_back({Kind::VectorTail, value});
+    } else {
+        PrintAtom(value);
+    }
+}
+
+void Printer::PrintAtom(const Value &value) {
+    if (value.IsFixnum()) {
+        WriteInteger(value.GetFixnum());
+    } else if (!value) {
+        buffer_ += "()";
+    } else if (value.IsBoolean()) {
+        buffer_ += value.GetBoolean() ? "#t" : "#f";
+    } else if (auto number = As<Number>(value)) {
+        buffer_ += number->GetValue().ToString();
+    } else if (auto symbol = As<Symbol>(value)) {
+        buffer_ += symbol->GetName();
+    } else if (auto primitive = As<Primitive>(value)) {
+        buffer_ += "#[compiled-procedure ";
+        buffer_ += SymbolTable::Instance().GetName(primitive->GetId());
+        buffer_ += ']';
+    } else if (auto closure = As<Closure>(value)) {
+        buffer_ += "#[compound-procedure";
+
+        if (auto name = closure->GetCode()->GetName()) {
+            buffer_ += ' ';
+            buffer_ += SymbolTable::Instance().GetName(*name);
+        }
+
+        buffer_ += ']';
+    }
+}
+
+void Printer::WriteInteger(int64_t value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+
+    buffer_.append(digits, result.ptr);
+}
+
+void Printer::Write(std::string_view text) {
+    buffer_ += text;
+    FlushIfFull();
+}
+
+std::string_view Printer::GetView() const { return buffer_; }
+
+void Printer::Clear() { buffer_.clear(); }
+
+void Printer::FlushIfFull() {
+    if (fd_ >= 0 && buffer_.size() >= kBufferSize) {
+        Flush();
+    }
+}
+
+void Printer::Flush() {
+    if (fd_ < 0) {
+        return;
+    }
+
+    size_t written = 0;
+
+    while (written != buffer_.size()) {
+        ssize_t size =
+            write(fd_, buffer_.data() + written, buffer_.size() - written);
+
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size < 0) {
+            buffer_.clear();
+            throw RuntimeError{std::string{"Cannot write output: "} +
+                               std::strerror(errno)};
+        }
+
+        written += size;
+    }
+
+    buffer_.clear();
+}
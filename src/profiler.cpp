@@ -0,0 +1,129 @@
+#include "utils/profiler.h"
+#include "utils/symbol_table.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+
+namespace {
+
+thread_local Profiler *current_profiler = nullptr;
+
+double ToSeconds(uint64_t ns) { return static_cast<double>(ns) * 1e-9; }
+
+} // namespace
+
+uint64_t Profiler::Histogram::GetBound(size_t bucket) {
+    return uint64_t{1} << (kMinExponent + bucket);
+}
+
+void Profiler::Histogram::Record(uint64_t ns) {
+    // the number of bits of ns - 1 is the exponent of the bound above it
+    int exponent = std::bit_width(ns == 0 ? 0 : ns - 1);
+    size_t bucket = std::clamp(exponent - kMinExponent, 0,
+                               static_cast<int>(kBucketCount) - 1);
+
+    ++buckets_[bucket];
+    ++count_;
+    sum_ += ns;
+}
+
+uint64_t Profiler::Histogram::GetCount() const { return count_; }
+
+uint64_t Profiler::Histogram::GetSum() const { return sum_; }
+
+uint64_t Profiler::Histogram::GetBucket(size_t bucket) const {
+    return buckets_[bucket];
+}
+
+Profiler::Timer::Timer(Profiler &profiler, Phase phase)
+    : profiler_(profiler), phase_(phase) {
+    if (profiler_.enabled_) {
+        start_ = std::chrono::steady_clock::now();
+    }
+}
+
+Profiler::Timer::~Timer() {
+    if (profiler_.enabled_) {
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+
+        profiler_.phases_[static_cast<size_t>(phase_)].Record(
+            std::chrono::nanoseconds{elapsed}.count());
+    }
+}
+
+Profiler::Scope::Scope(Profiler *profiler)
+    : previous_(std::exchange(current_profiler, profiler)) {}
+
+Profiler::Scope::~Scope() { current_profiler = previous_; }
+
+Profiler *Profiler::Current() { return current_profiler; }
+
+bool Profiler::IsEnabled() const { return enabled_; }
+
+void Profiler::SetEnabled(bool enabled) { enabled_ = enabled; }
+
+void Profiler::CountQuery() {
+    if (enabled_) {
+        ++queries_;
+    }
+}
+
+uint64_t Profiler::GetQueryCount() const { return queries_; }
+
+const Profiler::Histogram &Profiler::GetHistogram(Phase phase) const {
+    return phases_[static_cast<size_t>(phase)];
+}
+
+uint64_t *Profiler::GetCallCounts() { return calls_.data(); }
+
+uint64_t Profiler::GetCallCount(SymbolId id) const { return calls_[id]; }
+
+void Profiler::WriteOpenMetrics(std::ostream &out) const {
+    out << "# TYPE scheme_queries counter\n"
+        << "# HELP scheme_queries Queries run while profiling.\n"
+        << "scheme_queries_total " << queries_ << "\n";
+
+    out << "# TYPE scheme_phase_seconds histogram\n"
+        << "# UNIT scheme_phase_seconds seconds\n"
+        << "# HELP scheme_phase_seconds Time spent in a phase of a query.\n";
+
+    for (size_t phase = 0; phase < kPhaseCount; ++phase) {
+        const auto &histogram = phases_[phase];
+        std::string label = std::string{"phase=\""} + kPhaseNames[phase] + '"';
+        uint64_t cumulative = 0;
+
+        // buckets are cumulative, the last one is +Inf
+        for (size_t bucket = 0; bucket + 1 < Histogram::kBucketCount;
+             ++bucket) {
+            cumulative += histogram.GetBucket(bucket);
+            out << "scheme_phase_seconds_bucket{" << label << ",le=\""
+                << ToSeconds(Histogram::GetBound(bucket)) << "\"} "
+                << cumulative << "\n";
+        }
+
+        out << "scheme_phase_seconds_bucket{" << label << ",le=\"+Inf\"} "
+            << histogram.GetCount() << "\n"
+            << "scheme_phase_seconds_count{" << label << "} "
+            << histogram.GetCount() << "\n"
+            << "scheme_phase_seconds_sum{" << label << "} "
+            << ToSeconds(histogram.GetSum()) << "\n";
+    }
+
+    out << "# TYPE scheme_builtin_calls counter\n"
+        << "# HELP scheme_builtin_calls Calls of a builtin procedure.\n";
+
+    for (SymbolId id = 0; id < kWellKnownSymbolCount; ++id) {
+        if (calls_[id] != 0) {
+            out << "scheme_builtin_calls_total{builtin=\""
+                << kWellKnownNames[id] << "\"} " << calls_[id] << "\n";
+        }
+    }
+
+    out << "# EOF\n";
+}
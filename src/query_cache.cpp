@@ -0,0 +1,79 @@
+#include "utils/query_cache.h"
+#include "utils/base_object.h"
+#include "utils/heap.h"
+
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+QueryCache::QueryCache(Heap &heap, size_t capacity)
+    : heap_(heap), capacity_(capacity) {
+    heap_.AddRoots(&codes_);
+}
+
+QueryCache::~QueryCache() { heap_.RemoveRoots(&codes_); }
+
+Object::NodeType QueryCache::Find(std::string_view query, uint64_t version) {
+    auto it = index_.find(query);
+
+    if (it == index_.end()) {
+        ++stats_.misses;
+        return nullptr;
+    }
+
+    auto entry = it->second;
+
+    if (entry->version != version) {
+        Erase(entry);
+        ++stats_.misses;
+        return nullptr;
+    }
+
+    entries_.splice(entries_.begin(), entries_, entry);
+    ++stats_.hits;
+
+    return codes_[entry->slot];
+}
+
+void QueryCache::Insert(std::string_view query, Object::NodeType code,
+                        uint64_t version) {
+    if (capacity_ == 0 || query.size() > kMaxQueryLength) {
+        return;
+    }
+
+    if (auto it = index_.find(query); it != index_.end()) {
+        Erase(it->second);
+    }
+
+    if (entries_.size() == capacity_) {
+        Erase(std::prev(entries_.end()));
+    }
+
+    size_t slot = codes_.size();
+
+    if (free_slots_.empty()) {
+        codes_.push_back(code);
+    } else {
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+        codes_[slot] = code;
+    }
+
+    entries_.push_front({std::string{query}, version, slot});
+    index_.emplace(entries_.front().query, entries_.begin());
+}
+
+QueryCache::Stats QueryCache::GetStats() const {
+    auto stats = stats_;
+    stats.size = entries_.size();
+
+    return stats;
+}
+
+void QueryCache::Erase(std::list<Entry>::iterator entry) {
+    index_.erase(entry->query);
+    codes_[entry->slot] = nullptr;
+    free_slots_.push_back(entry->slot);
+    entries_.erase(entry);
+}
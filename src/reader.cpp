@@ -0,0 +1,64 @@
+#include "utils/reader.h"
+#include "utils/tokenizer.h"
+
+#include <algorithm>
+#include <optional>
+#include <string_view>
+
+void Reader::Feed(std::string_view text) {
+    // drop the data handed out already
+    size_t consumed = in_datum_ ? start_ : position_;
+
+    buffer_.erase(0, consumed);
+    start_ -= std::min(start_, consumed);
+    position_ -= consumed;
+
+    buffer_.append(text);
+}
+
+void Reader::Finish() { finished_ = true; }
+
+std::optional<std::string_view> Reader::Next() {
+    std::string_view source = buffer_;
+
+    while (auto span = ScanToken(source, position_)) {
+        // an atom may go on in the next chunk
+        bool atom = span->type != TokenType::OpenBracket &&
+                    span->type != TokenType::CloseBracket &&
+                    span->type != TokenType::Quote &&
+                    span->type != TokenType::Dot;
+
+        if (atom && span->end == source.size() && !finished_) {
+            return std::nullopt;
+        }
+
+        if (!in_datum_) {
+            start_ = span->begin;
+            in_datum_ = true;
+        }
+
+        position_ = span->end;
+
+        if (span->type == TokenType::OpenBracket) {
+            ++depth_;
+        } else if (span->type == TokenType::CloseBracket && depth_ != 0) {
+            --depth_;
+        }
+
+        // a quote prefixes the datum that follows it
+        if (depth_ == 0 && span->type != TokenType::Quote) {
+            in_datum_ = false;
+            return source.substr(start_, position_ - start_);
+        }
+    }
+
+    position_ = source.size();
+
+    if (finished_ && in_datum_) {
+        in_datum_ = false;
+        depth_ = 0;
+        return source.substr(start_);
+    }
+
+    return std::nullopt;
+}
@@ -0,0 +1,344 @@
+#include "utils/reductions.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace {
+
+static_assert(sizeof(Value) == sizeof(uint64_t) &&
+              std::is_trivially_copyable_v<Value>);
+
+// The scalar kernels, also the tails of the vector ones.
+
+std::optional<int64_t> ScalarSum(const Value *values, size_t count) {
+    int64_t sum = 0;
+
+    for (size_t i = 0; i != count; ++i) {
+        if (!values[i].IsFixnum() ||
+            __builtin_add_overflow(sum, values[i].GetFixnum(), &sum)) {
+            return std::nullopt;
+        }
+    }
+
+    return sum;
+}
+
+template <bool kMax>
+std::optional<Value> ScalarExtremum(const Value *values, size_t count) {
+    int64_t best = values[0].GetFixnum();
+
+    for (size_t i = 0; i != count; ++i) {
+        if (!values[i].IsFixnum()) {
+            return std::nullopt;
+        }
+
+        int64_t value = values[i].GetFixnum();
+        best = kMax ? std::max(best, value) : std::min(best, value);
+    }
+
+    return Value::Fixnum(best);
+}
+
+bool Holds(Relation relation, int64_t lhs, int64_t rhs) {
+    switch (relation) {
+    case Relation::Equal:
+        return lhs == rhs;
+    case Relation::Less:
+        return lhs < rhs;
+    case Relation::LessEqual:
+        return lhs <= rhs;
+    case Relation::Greater:
+        return lhs > rhs;
+    case Relation::GreaterEqual:
+        return lhs >= rhs;
+    }
+
+    return false;
+}
+
+std::optional<bool> ScalarCompare(const Value *values, size_t count,
+                                  Relation relation) {
+    bool result = true;
+
+    // every value is checked, even after the result is known
+    for (size_t i = 0; i != count; ++i) {
+        if (!values[i].IsFixnum()) {
+            return std::nullopt;
+        }
+        if (i != 0 && result) {
+            result = Holds(relation, values[i - 1].GetFixnum(),
+                           values[i].GetFixnum());
+        }
+    }
+
+    return result;
+}
+
+// The vector kernels are written once with the vector extension of GCC and
+// Clang and inlined into functions compiled for each instruction set.
+// Vector is a vector of int64_t, its lanes hold the tagged words.
+
+template <class Vector>
+constexpr size_t kLanes = sizeof(Vector) / sizeof(uint64_t);
+
+// Filled through a pointer, returning a vector would depend on the ABI.
+template <class Vector>
+[[gnu::always_inline]] inline void Load(const Value *values, Vector *words) {
+    std::memcpy(words, values, sizeof(*words));
+}
+
+// Whether bit 0 of every lane is set.
+template <class Vector>
+[[gnu::always_inline]] inline bool AllTagged(const Vector &tags) {
+    uint64_t all = -1;
+
+    for (size_t lane = 0; lane != kLanes<Vector>; ++lane) {
+        all &= tags[lane];
+    }
+
+    return all & 1;
+}
+
+// A lane sums fixnums shifted left by one, their tag bits cleared, so that
+// the additions that overflow are those leaving the fixnum range. Unsigned
+// is the vector of uint64_t of the same size, it wraps.
+template <class Unsigned>
+[[gnu::always_inline]] inline std::optional<int64_t>
+VectorSum(const Value *values, size_t count) {
+    constexpr size_t kStep = kLanes<Unsigned>;
+
+    Unsigned sums{};
+    Unsigned tags = ~Unsigned{};
+    Unsigned overflows{};
+    size_t i = 0;
+
+    for (; i + kStep <= count; i += kStep) {
+        Unsigned words;
+        Load(values + i, &words);
+        tags &= words;
+        words &= ~uint64_t{1};
+
+        // the sign of the result differs from those of both operands
+        Unsigned next = sums + words;
+        overflows |= (sums ^ next) & (words ^ next);
+        sums = next;
+    }
+
+    if (!AllTagged(tags)) {
+        return std::nullopt;
+    }
+
+    int64_t sum = 0;
+
+    for (size_t lane = 0; lane != kStep; ++lane) {
+        if (overflows[lane] >> 63 ||
+            __builtin_add_overflow(
+                sum, static_cast<int64_t>(sums[lane]) >> 1, &sum)) {
+            return std::nullopt;
+        }
+    }
+
+    auto tail = ScalarSum(values + i, count - i);
+
+    if (!tail || __builtin_add_overflow(sum, *tail, &sum)) {
+        return std::nullopt;
+    }
+
+    return sum;
+}
+
+// Tagging keeps the order, the words are compared as they are.
+template <class Vector, bool kMax>
+[[gnu::always_inline]] inline std::optional<Value>
+VectorExtremum(const Value *values, size_t count) {
+    constexpr size_t kStep = kLanes<Vector>;
+
+    if (count < kStep) {
+        return ScalarExtremum<kMax>(values, count);
+    }
+
+    Vector best;
+    Load(values, &best);
+    Vector tags = best;
+    size_t i = kStep;
+
+    for (; i + kStep <= count; i += kStep) {
+        Vector words;
+        Load(values + i, &words);
+        tags &= words;
+        best = kMax ? (words > best ? words : best)
+                    : (words < best ? words : best);
+    }
+
+    if (!AllTagged(tags)) {
+        return std::nullopt;
+    }
+
+    auto result = ScalarExtremum<kMax>(values + i - 1, count - i + 1);
+
+    if (!result) {
+        return std::nullopt;
+    }
+
+    int64_t word = result->GetFixnum();
+
+    for (size_t lane = 0; lane != kStep; ++lane) {
+        int64_t value = best[lane] >> 1;
+        word = kMax ? std::max(word, value) : std::min(word, value);
+    }
+
+    return Value::Fixnum(word);
+}
+
+// Lanes compare a run of the values with the run one further.
+template <class Vector, Relation kRelation>
+[[gnu::always_inline]] inline std::optional<bool>
+VectorCompare(const Value *values, size_t count) {
+    constexpr size_t kStep = kLanes<Vector>;
+
+    Vector tags = ~Vector{};
+    Vector failed{};
+    size_t i = 0;
+
+    for (; i + kStep < count; i += kStep) {
+        Vector lhs, rhs;
+        Load(values + i, &lhs);
+        Load(values + i + 1, &rhs);
+        tags &= lhs;
+
+        if constexpr (kRelation == Relation::Equal) {
+            failed |= lhs != rhs;
+        } else if constexpr (kRelation == Relation::Less) {
+            failed |= lhs >= rhs;
+        } else if constexpr (kRelation == Relation::LessEqual) {
+            failed |= lhs > rhs;
+        } else if constexpr (kRelation == Relation::Greater) {
+            failed |= lhs <= rhs;
+        } else {
+            failed |= lhs < rhs;
+        }
+    }
+
+    // the tail starts with the last value compared, its pairs are the rest
+    auto tail = ScalarCompare(values + i, count - i, kRelation);
+
+    if (!tail || !AllTagged(tags)) {
+        return std::nullopt;
+    }
+
+    bool result = *tail;
+
+    for (size_t lane = 0; lane != kStep; ++lane) {
+        result = result && !failed[lane];
+    }
+
+    return result;
+}
+
+template <class Vector>
+[[gnu::always_inline]] inline std::optional<bool>
+VectorCompare(const Value *values, size_t count, Relation relation) {
+    switch (relation) {
+    case Relation::Equal:
+        return VectorCompare<Vector, Relation::Equal>(values, count);
+    case Relation::Less:
+        return VectorCompare<Vector, Relation::Less>(values, count);
+    case Relation::LessEqual:
+        return VectorCompare<Vector, Relation::LessEqual>(values, count);
+    case Relation::Greater:
+        return VectorCompare<Vector, Relation::Greater>(values, count);
+    case Relation::GreaterEqual:
+        return VectorCompare<Vector, Relation::GreaterEqual>(values, count);
+    }
+
+    return std::nullopt;
+}
+
+struct Kernels {
+    const char *isa;
+    std::optional<int64_t> (*sum)(const Value *, size_t);
+    std::optional<Value> (*min)(const Value *, size_t);
+    std::optional<Value> (*max)(const Value *, size_t);
+    std::optional<bool> (*compare)(const Value *, size_t, Relation);
+};
+
+const Kernels kScalarKernels{"scalar", ScalarSum, ScalarExtremum<false>,
+                             ScalarExtremum<true>, ScalarCompare};
+
+#if defined(__x86_64__)
+
+// Instantiates the vector kernels for an instruction set.
+#define KERNELS(name, isa, Vector, Unsigned)                                  \
+    [[gnu::target(isa)]] std::optional<int64_t> name##Sum(                     \
+        const Value *values, size_t count) {                                   \
+        return VectorSum<Unsigned>(values, count);                             \
+    }                                                                          \
+    [[gnu::target(isa)]] std::optional<Value> name##Min(const Value *values,   \
+                                                        size_t count) {        \
+        return VectorExtremum<Vector, false>(values, count);                   \
+    }                                                                          \
+    [[gnu::target(isa)]] std::optional<Value> name##Max(const Value *values,   \
+                                                        size_t count) {        \
+        return VectorExtremum<Vector, true>(values, count);                    \
+    }                                                                          \
+    [[gnu::target(isa)]] std::optional<bool> name##Compare(                    \
+        const Value *values, size_t count, Relation relation) {                \
+        return VectorCompare<Vector>(values, count, relation);                 \
+    }                                                                          \
+    const Kernels k##name##Kernels{isa, name##Sum, name##Min, name##Max,       \
+                                   name##Compare};
+
+using Vector2 = int64_t __attribute__((vector_size(16)));
+using Vector4 = int64_t __attribute__((vector_size(32)));
+using Unsigned2 = uint64_t __attribute__((vector_size(16)));
+using Unsigned4 = uint64_t __attribute__((vector_size(32)));
+
+KERNELS(Sse42, "sse4.2", Vector2, Unsigned2)
+KERNELS(Avx2, "avx2", Vector4, Unsigned4)
+
+#undef KERNELS
+
+#endif
+
+const Kernels &SelectKernels() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+        return kAvx2Kernels;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        return kSse42Kernels;
+    }
+#endif
+
+    return kScalarKernels;
+}
+
+const Kernels &GetKernels() {
+    static const Kernels &kernels = SelectKernels();
+
+    return kernels;
+}
+
+} // namespace
+
+std::optional<int64_t> SumFixnums(const Value *values, size_t count) {
+    return GetKernels().sum(values, count);
+}
+
+std::optional<Value> MinFixnum(const Value *values, size_t count) {
+    return GetKernels().min(values, count);
+}
+
+std::optional<Value> MaxFixnum(const Value *values, size_t count) {
+    return GetKernels().max(values, count);
+}
+
+std::optional<bool> CompareFixnums(const Value *values, size_t count,
+                                   Relation relation) {
+    return GetKernels().compare(values, count, relation);
+}
+
+const char *GetReductionIsa() { return GetKernels().isa; }
@@ -1,49 +1,260 @@
 #include "utils/scheme.h"
 #include "utils/base_object.h"
+#include "utils/bytecode.h"
+#include "utils/compiler.h"
 #include "utils/error.h"
+#include "utils/fasl.h"
+#include "utils/globals.h"
+#include "utils/heap.h"
+#include "utils/image.h"
+#include "utils/mapped_file.h"
 #include "utils/object.h"
 #include "utils/parser.h"
+#include "utils/printer.h"
+#include "utils/profiler.h"
+#include "utils/query_cache.h"
+#include "utils/reader.h"
 #include "utils/tokenizer.h"
+#include "utils/vm.h"
 
-#include <cassert>
-#include <iostream>
-#include <sstream>
+#include <new>
 
-// #define DEBUG
+std::string Interpreter::Run(std::string_view query) {
+    printer_.Clear();
+    Run(query, &printer_);
 
-std::string Interpreter::Run(const std::string &query) {
-    std::stringstream ss{query};
-    tokenizer_.Update(&ss);
+    return std::string{printer_.GetView()};
+}
+
+void Interpreter::Run(std::string_view query, Printer *printer) {
+    Heap::Scope scope{&heap_};
+    Profiler::Scope profiler_scope{&profiler_};
+
+    auto result = EvaluateQuery(query);
+
+    Profiler::Timer timer{profiler_, Profiler::Phase::Print};
+    printer->Print(result);
+}
+
+bool Interpreter::TryRun(std::string_view query, std::string *output) {
+    printer_.Clear();
+
+    if (!TryRun(query, &printer_, output)) {
+        return false;
+    }
+
+    *output = printer_.GetView();
+    return true;
+}
+
+bool Interpreter::TryRun(std::string_view query, Printer *printer,
+                         std::string *error) {
+    try {
+        Run(query, printer);
+        return true;
+    } catch (const SyntaxError &syntax_error) {
+        *error = std::string{"SyntaxError: "} + syntax_error.what();
+    } catch (const NameError &name_error) {
+        *error = std::string{"NameError: "} + name_error.what();
+    } catch (const RuntimeError &runtime_error) {
+        *error = std::string{"RuntimeError: "} + runtime_error.what();
+    } catch (const std::bad_alloc &) {
+        *error = "RuntimeError: Out of memory";
+    } catch (...) {
+        *error = "unknown exception";
+    }
+
+    return false;
+}
+
+Root Interpreter::Evaluate(std::string_view query) {
+    Heap::Scope scope{&heap_};
+    Profiler::Scope profiler_scope{&profiler_};
+
+    return Root{heap_, EvaluateQuery(query)};
+}
+
+std::vector<SymbolId> Interpreter::GetDefinedGlobals() const {
+    std::vector<SymbolId> names;
+
+    for (uint32_t slot = 0; slot != globals_.GetSlotCount(); ++slot) {
+        if (globals_.IsDefined(globals_.GetName(slot))) {
+            names.push_back(globals_.GetName(slot));
+        }
+    }
+
+    return names;
+}
+
+Heap::Stats Interpreter::GetHeapStats() const { return heap_.GetStats(); }
+
+CompileStats Interpreter::GetCompileStats() const { return compile_stats_; }
+
+void Interpreter::SetProfiling(bool enabled) {
+    profiler_.SetEnabled(enabled);
+}
+
+const Profiler &Interpreter::GetProfiler() const { return profiler_; }
+
+QueryCache::Stats Interpreter::GetQueryCacheStats() const {
+    return query_cache_.GetStats();
+}
+
+Object::NodeType Interpreter::EvaluateQuery(std::string_view query) {
+    profiler_.CountQuery();
+
+    auto version = globals_.GetVersion();
+    auto code = query_cache_.Find(query, version);
+
+    if (!code) {
+        Object::NodeType ast;
+
+        {
+            Profiler::Timer timer{profiler_, Profiler::Phase::Read};
+            tokenizer_.Update(query);
+            ast = Read(&tokenizer_);
+        }
+
+        code = CompileDatum(ast);
+        query_cache_.Insert(query, code, version);
+    }
 
-    auto ast = Read(&tokenizer_);
+    Profiler::Timer timer{profiler_, Profiler::Phase::Evaluate};
 
-#ifdef DEBUG
-    std::cout << ast << std::endl;
-    std::cout << "----------------" << std::endl;
-#endif
+    return vm_.Execute(As<Code>(code));
+}
 
+Object::NodeType Interpreter::CompileDatum(const Object::NodeType &ast) {
     if (!ast) {
         throw RuntimeError{"nullptr cannot be called"};
     }
 
-    // std::vector<Object::NodeType>
-    Object::NodeType args;
-    if (!Is<Number>(ast)) {
+    Profiler::Timer timer{profiler_, Profiler::Phase::Compile};
+
+    return Compile(ast, globals_, &compile_stats_);
+}
+
+std::string Interpreter::RunFile(const std::string &path) {
+    MappedFile file{path};
+    Reader reader;
+    std::string result;
+
+    reader.Feed(file.GetView());
+    reader.Finish();
+
+    while (auto datum = reader.Next()) {
+        result = Run(*datum);
+    }
+
+    return result;
+}
+
+std::string Interpreter::Load(const std::string &path) {
+    MappedFile source{path};
+    auto hash = HashContent(source.GetView());
+    auto fasl_path = path + ".fasl";
+    std::optional<MappedFile> fasl_file;
+    std::optional<std::string> built;
+    std::optional<FaslReader> reader;
 
-        ast = ast->Call(args);
+    try {
+        fasl_file.emplace(fasl_path);
+        reader = FaslReader::Open(fasl_file->GetView(), hash,
+                                  source.GetView().size());
+    } catch (const RuntimeError &) {
+        // not built yet
     }
 
-    std::stringstream output;
+    if (!reader) {
+        built = BuildFasl(source.GetView(), hash);
+
+        // a datum the parser rejects is reported as RunFile does it
+        if (!built) {
+            return RunFile(path);
+        }
 
-    if (Is<Cell>(ast)) {
-        output << "(";
+        WriteFileAtomically(fasl_path, *built);
+        reader = FaslReader::Open(*built, hash, source.GetView().size());
     }
 
-    output << ast;
+    std::string result;
+    std::optional<Heap::Scope> scope;
+
+    while (true) {
+        RenewLoadScope(&scope);
+        Profiler::Scope profiler_scope{&profiler_};
+        std::optional<Object::NodeType> datum;
+
+        {
+            Profiler::Timer timer{profiler_, Profiler::Phase::Read};
+            datum = reader->Next();
+        }
+
+        if (!datum) {
+            break;
+        }
 
-    if (Is<Cell>(ast)) {
-        output << ")";
+        profiler_.CountQuery();
+
+        auto code = CompileDatum(*datum);
+        Object::NodeType value;
+
+        {
+            Profiler::Timer timer{profiler_, Profiler::Phase::Evaluate};
+            value = vm_.Execute(As<Code>(code));
+        }
+
+        Profiler::Timer timer{profiler_, Profiler::Phase::Print};
+        printer_.Clear();
+        printer_.Print(value);
+        result = printer_.GetView();
     }
 
-    return output.str();
+    return result;
+}
+
+void Interpreter::SaveImage(const std::string &path) {
+    if (!WriteFileAtomically(path, WriteImage(globals_))) {
+        throw RuntimeError{"Cannot write image " + path};
+    }
+}
+
+void Interpreter::LoadImage(const std::string &path) {
+    MappedFile file{path};
+
+    ReadImage(file.GetView(), heap_, &globals_);
+}
+
+std::optional<std::string> Interpreter::BuildFasl(std::string_view source,
+                                                  uint64_t hash) {
+    Reader reader;
+    FaslWriter writer;
+
+    std::optional<Heap::Scope> scope;
+
+    reader.Feed(source);
+    reader.Finish();
+
+    while (auto datum = reader.Next()) {
+        RenewLoadScope(&scope);
+
+        try {
+            tokenizer_.Update(*datum);
+
+            if (!writer.Add(Read(&tokenizer_))) {
+                return std::nullopt;
+            }
+        } catch (const SyntaxError &) {
+            return std::nullopt;
+        }
+    }
+
+    return writer.Finish(hash, source.size());
+}
+
+void Interpreter::RenewLoadScope(std::optional<Heap::Scope> *scope) {
+    if (!*scope || heap_.GetStats().nursery_bytes > kLoadBatchBytes) {
+        scope->reset();
+        scope->emplace(&heap_);
+    }
 }
@@ -0,0 +1,492 @@
+#include "utils/server.h"
+#include "utils/error.h"
+#include "utils/scheme.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// epoll data of the descriptors that are not connections
+constexpr uint64_t kListenId = 0;
+constexpr uint64_t kEventId = 1;
+
+void ThrowSystemError(const std::string &what) {
+    throw RuntimeError{what + ": " + std::strerror(errno)};
+}
+
+// Whether nothing listens on the Unix domain socket any more.
+bool IsAbandoned(const sockaddr_un &address) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    bool refused =
+        connect(fd, reinterpret_cast<const sockaddr *>(&address),
+                sizeof(address)) != 0 &&
+        errno == ECONNREFUSED;
+    close(fd);
+
+    return refused;
+}
+
+} // namespace
+
+Server::Server(const Options &options) : next_id_(kEventId + 1) {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (epoll_fd_ < 0 || event_fd_ < 0) {
+        CloseDescriptors();
+        ThrowSystemError("Cannot create epoll");
+    }
+
+    epoll_event event{EPOLLIN, {.u64 = kEventId}};
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, event_fd_, &event);
+
+    // the destructor does not run for a server that fails to start
+    try {
+        Listen(options);
+
+        for (size_t i = 0; i < std::max<size_t>(options.workers, 1); ++i) {
+            workers_.push_back(std::make_unique<Worker>());
+
+            if (!options.image.empty()) {
+                workers_.back()->interpreter.LoadImage(options.image);
+            }
+            for (const auto &path : options.preludes) {
+                workers_.back()->interpreter.Load(path);
+            }
+        }
+    } catch (...) {
+        CloseDescriptors();
+        throw;
+    }
+    for (auto &worker : workers_) {
+        worker->thread = std::thread{[this, &worker] { Work(worker.get()); }};
+    }
+}
+
+Server::~Server() {
+    stopping_ = true;
+
+    for (auto &worker : workers_) {
+        {
+            std::lock_guard lock{worker->mutex};
+        }
+        worker->ready.notify_one();
+
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+
+    for (auto &[id, connection] : connections_) {
+        close(connection.fd);
+    }
+
+    CloseDescriptors();
+}
+
+void Server::CloseDescriptors() {
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+    }
+    if (!path_.empty()) {
+        unlink(path_.c_str());
+    }
+    if (event_fd_ >= 0) {
+        close(event_fd_);
+    }
+    if (epoll_fd_ >= 0) {
+        close(epoll_fd_);
+    }
+}
+
+void Server::Listen(const Options &options) {
+    int result;
+
+    if (!options.path.empty()) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+
+        if (options.path.size() >= sizeof(address.sun_path)) {
+            throw RuntimeError{"Socket path is too long: " + options.path};
+        }
+
+        std::memcpy(address.sun_path, options.path.data(),
+                    options.path.size());
+
+        // a socket left by a server that is gone would fail the bind, the
+        // one of a live server is left to it
+        struct stat info;
+        if (stat(options.path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode) &&
+            IsAbandoned(address)) {
+            unlink(options.path.c_str());
+        }
+
+        listen_fd_ =
+            socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        result = listen_fd_ < 0
+                     ? -1
+                     : bind(listen_fd_, reinterpret_cast<sockaddr *>(&address),
+                            sizeof(address));
+
+        if (result == 0) {
+            path_ = options.path;
+        }
+    } else {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(options.port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        listen_fd_ =
+            socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+        int reuse = 1;
+        result = listen_fd_ < 0
+                     ? -1
+                     : setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse,
+                                  sizeof(reuse));
+
+        if (result == 0) {
+            result = bind(listen_fd_, reinterpret_cast<sockaddr *>(&address),
+                          sizeof(address));
+        }
+    }
+
+    if (result != 0 || listen(listen_fd_, SOMAXCONN) != 0) {
+        ThrowSystemError("Cannot listen");
+    }
+
+    epoll_event event{EPOLLIN, {.u64 = kListenId}};
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event);
+}
+
+void Server::Run() {
+    constexpr int kMaxEvents = 64;
+    epoll_event events[kMaxEvents];
+
+    while (!stopping_) {
+        int count = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("epoll_wait failed");
+        }
+
+        for (int i = 0; i < count; ++i) {
+            uint64_t id = events[i].data.u64;
+
+            if (id == kListenId) {
+                Accept();
+                continue;
+            }
+            if (id == kEventId) {
+                uint64_t value;
+                while (read(event_fd_, &value, sizeof(value)) > 0) {
+                }
+                DeliverResponses();
+                continue;
+            }
+
+            auto it = connections_.find(id);
+
+            // closed by an earlier event of this round
+            if (it == connections_.end()) {
+                continue;
+            }
+
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                Close(id);
+                continue;
+            }
+            if (events[i].events & EPOLLIN) {
+                Read(id, &it->second);
+            }
+            if (events[i].events & EPOLLOUT) {
+                Write(id, &it->second);
+            }
+
+            Update(id, &it->second);
+        }
+    }
+}
+
+void Server::Stop() {
+    stopping_ = true;
+
+    uint64_t value = 1;
+    [[maybe_unused]] auto written = write(event_fd_, &value, sizeof(value));
+}
+
+void Server::Work(Worker *worker) {
+    std::string output;
+
+    while (true) {
+        Request request;
+
+        {
+            std::unique_lock lock{worker->mutex};
+            worker->ready.wait(lock, [&] {
+                return stopping_ || !worker->requests.empty();
+            });
+
+            if (stopping_) {
+                return;
+            }
+
+            request = std::move(worker->requests.front());
+            worker->requests.pop_front();
+        }
+
+        bool succeeded = worker->interpreter.TryRun(request.query, &output);
+        std::string line = (succeeded ? "> " : "! ") + output + '\n';
+        bool wake;
+
+        {
+            std::lock_guard lock{responses_mutex_};
+            wake = responses_.empty();
+            responses_.push_back({request.connection, std::move(line)});
+        }
+
+        // the I/O thread takes all the responses at once
+        if (wake) {
+            uint64_t value = 1;
+            [[maybe_unused]] auto written =
+                write(event_fd_, &value, sizeof(value));
+        }
+    }
+}
+
+void Server::Accept() {
+    while (true) {
+        int fd = accept4(listen_fd_, nullptr, nullptr,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if (fd < 0) {
+            return;
+        }
+
+        int no_delay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+
+        uint64_t id = next_id_++;
+        Connection connection{fd, next_worker_++ % workers_.size(), {}, {}};
+
+        connection.events = EPOLLIN;
+
+        epoll_event event{connection.events, {.u64 = id}};
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+
+        connections_.emplace(id, std::move(connection));
+    }
+}
+
+void Server::Read(uint64_t id, Connection *connection) {
+    char buffer[kReadSize];
+
+    while (true) {
+        ssize_t size = read(connection->fd, buffer, sizeof(buffer));
+
+        if (size > 0) {
+            connection->input.append(buffer, size);
+            continue;
+        }
+        if (size == 0) {
+            connection->eof = true;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            connection->eof = true;
+            connection->input.clear();
+        }
+        break;
+    }
+
+    Dispatch(id, connection);
+}
+
+void Server::Dispatch(uint64_t id, Connection *connection) {
+    // a client that does not read its responses gets no more of them
+    if (connection->output.size() >= kMaxOutput) {
+        return;
+    }
+
+    std::vector<Request> requests;
+    std::string_view input = connection->input;
+    size_t begin = 0;
+
+    // the lines past the pipeline limit wait in the input
+    auto full = [&] {
+        return connection->pending + requests.size() >= kMaxPipeline;
+    };
+
+    for (size_t end; !full() && (end = input.find('\n', begin)) != input.npos;
+         begin = end + 1) {
+        auto line = input.substr(begin, end - begin);
+
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.find_first_not_of(" \t") != line.npos) {
+            requests.push_back({id, std::string{line}});
+        }
+    }
+
+    // the last line of the input may lack its newline
+    if (connection->eof && !full() && begin != input.size()) {
+        requests.push_back({id, std::string{input.substr(begin)}});
+        begin = input.size();
+    }
+
+    connection->input.erase(0, begin);
+
+    if (!full() && connection->input.size() > kMaxLine) {
+        connection->output += "! SyntaxError: Query is too long\n";
+        connection->input.clear();
+        connection->eof = true;
+    }
+
+    if (requests.empty()) {
+        return;
+    }
+
+    connection->pending += requests.size();
+
+    auto &worker = *workers_[connection->worker];
+
+    {
+        std::lock_guard lock{worker.mutex};
+
+        for (auto &request : requests) {
+            worker.requests.push_back(std::move(request));
+        }
+    }
+
+    worker.ready.notify_one();
+}
+
+void Server::Write(uint64_t id, Connection *connection) {
+    size_t written = 0;
+
+    while (written != connection->output.size()) {
+        ssize_t size =
+            send(connection->fd, connection->output.data() + written,
+                 connection->output.size() - written, MSG_NOSIGNAL);
+
+        if (size > 0) {
+            written += size;
+        } else if (size < 0 && errno == EINTR) {
+            continue;
+        } else {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                // the peer is gone, nothing more can be delivered
+                connection->eof = true;
+                connection->input.clear();
+                written = connection->output.size();
+            }
+            break;
+        }
+    }
+
+    connection->output.erase(0, written);
+
+    // lines held back while the output was over its limit
+    if (written != 0 && !connection->input.empty()) {
+        Dispatch(id, connection);
+    }
+}
+
+void Server::DeliverResponses() {
+    std::vector<Response> responses;
+
+    {
+        std::lock_guard lock{responses_mutex_};
+        responses.swap(responses_);
+    }
+
+    for (auto &response : responses) {
+        auto it = connections_.find(response.connection);
+
+        if (it == connections_.end()) {
+            continue;
+        }
+
+        it->second.output += response.line;
+        --it->second.pending;
+    }
+
+    // one write per connection for all its responses
+    for (auto &response : responses) {
+        auto it = connections_.find(response.connection);
+
+        if (it == connections_.end() || it->second.output.empty()) {
+            continue;
+        }
+
+        // lines held back while the pipeline was full
+        if (!it->second.input.empty()) {
+            Dispatch(it->first, &it->second);
+        }
+
+        Write(it->first, &it->second);
+        Update(it->first, &it->second);
+    }
+}
+
+void Server::Update(uint64_t id, Connection *connection) {
+    if (connection->eof && connection->pending == 0 &&
+        connection->output.empty()) {
+        Close(id);
+        return;
+    }
+
+    uint32_t events = 0;
+
+    if (!connection->eof && connection->pending < kMaxPipeline &&
+        connection->output.size() < kMaxOutput) {
+        events |= EPOLLIN;
+    }
+    if (!connection->output.empty()) {
+        events |= EPOLLOUT;
+    }
+
+    if (events != connection->events) {
+        connection->events = events;
+
+        epoll_event event{events, {.u64 = id}};
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection->fd, &event);
+    }
+}
+
+void Server::Close(uint64_t id) {
+    auto it = connections_.find(id);
+
+    // queries still queued run anyway, their responses are dropped
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, it->second.fd, nullptr);
+    close(it->second.fd);
+    connections_.erase(it);
+}
@@ -0,0 +1,59 @@
+#include "utils/symbol_table.h"
+#include "utils/error.h"
+
+#include <mutex>
+
+SymbolTable &SymbolTable::Instance() {
+    static SymbolTable table;
+    return table;
+}
+
+SymbolTable::SymbolTable() {
+    for (auto name : kWellKnownNames) {
+        Intern(name);
+    }
+}
+
+SymbolId SymbolTable::Intern(std::string_view name) {
+    {
+        std::shared_lock lock{mutex_};
+
+        if (auto it = ids_.find(name); it != ids_.end()) {
+            return it->second;
+        }
+    }
+
+    std::unique_lock lock{mutex_};
+
+    // somebody could intern the same name between the two locks
+    if (auto it = ids_.find(name); it != ids_.end()) {
+        return it->second;
+    }
+
+    if (names_.size() == kMaxSymbols ||
+        bytes_ + name.size() > kMaxSymbolBytes) {
+        throw RuntimeError{"Too many symbols"};
+    }
+
+    SymbolId id = static_cast<SymbolId>(names_.size());
+    const std::string &stored = names_.emplace_back(name);
+    bytes_ += name.size();
+    ids_.emplace(stored, id);
+
+    return id;
+}
+
+std::string_view SymbolTable::GetName(SymbolId id) const {
+    std::shared_lock lock{mutex_};
+
+    if (id >= names_.size()) {
+        throw RuntimeError{"Unknown symbol id"};
+    }
+
+    return names_[id];
+}
+
+size_t SymbolTable::Size() const {
+    std::shared_lock lock{mutex_};
+    return names_.size();
+}
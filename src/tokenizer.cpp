@@ -1,17 +1,218 @@
 #include "utils/tokenizer.h"
 #include "utils/error.h"
 
-#include <cctype>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <optional>
 #include <string>
+#include <string_view>
 
-TokenType DefineType(const std::string &str) {
-    for (const auto &[type, regex] : kTokenRegexes) {
-        if (std::regex_match(str, regex)) {
-            return type;
+namespace {
+
+// The lexer is a DFA over the token grammar:
+//   Constant  (-|+)?[0-9]+
+//   Boolean   #t, #f (and the historical #| spelling of #f)
+//   Symbol    [a-zA-Z<=>*/#][a-zA-Z<=>*/#0-9?!-]*, single + * / or -,
+//             except #t/#f not followed by a word character
+//   Quote, Dot, OpenBracket, CloseBracket
+// A token is the longest run of characters every prefix of which is still
+// a valid token, so every non-accepting state is the dead state.
+
+enum CharClass : uint8_t {
+    kOther,
+    kDigit,
+    kLetter,
+    kBoolLetter,
+    kSymbolChar,
+    kSymbolTail,
+    kMinus,
+    kPlus,
+    kHash,
+    kPipe,
+    kQuote,
+    kDot,
+    kOpen,
+    kClose,
+    kCharClassCount
+};
+
+enum LexState : uint8_t {
+    kStart,
+    kIdentifier,
+    kHashPrefix,
+    kBoolean,
+    kPipeBoolean,
+    kSign,
+    kInteger,
+    kQuoteChar,
+    kDotChar,
+    kOpenChar,
+    kCloseChar,
+    kDead,
+    kLexStateCount
+};
+
+constexpr std::array<CharClass, 256> MakeCharClasses() {
+    std::array<CharClass, 256> classes{};
+
+    for (int c = '0'; c <= '9'; ++c) {
+        classes[c] = kDigit;
+    }
+    for (int c = 'a'; c <= 'z'; ++c) {
+        classes[c] = kLetter;
+        classes[c - 'a' + 'A'] = kLetter;
+    }
+    classes['t'] = kBoolLetter;
+    classes['f'] = kBoolLetter;
+    for (char c : {'<', '=', '>', '*', '/'}) {
+        classes[static_cast<uint8_t>(c)] = kSymbolChar;
+    }
+    classes['?'] = kSymbolTail;
+    classes['!'] = kSymbolTail;
+    classes['-'] = kMinus;
+    classes['+'] = kPlus;
+    classes['#'] = kHash;
+    classes['|'] = kPipe;
+    classes['\''] = kQuote;
+    classes['.'] = kDot;
+    classes['('] = kOpen;
+    classes[')'] = kClose;
+
+    return classes;
+}
+
+using TransitionRow = std::array<LexState, kCharClassCount>;
+
+constexpr TransitionRow MakeRow(LexState fallback) {
+    TransitionRow row{};
+    row.fill(fallback);
+    return row;
+}
+
+constexpr std::array<TransitionRow, kLexStateCount> MakeTransitions() {
+    std::array<TransitionRow, kLexStateCount> table{};
+    table.fill(MakeRow(kDead));
+
+    auto &start = table[kStart];
+    start[kDigit] = kInteger;
+    start[kLetter] = kIdentifier;
+    start[kBoolLetter] = kIdentifier;
+    start[kSymbolChar] = kIdentifier;
+    start[kMinus] = kSign;
+    start[kPlus] = kSign;
+    start[kHash] = kHashPrefix;
+    start[kQuote] = kQuoteChar;
+    start[kDot] = kDotChar;
+    start[kOpen] = kOpenChar;
+    start[kClose] = kCloseChar;
+
+    auto &identifier = table[kIdentifier];
+    for (auto c : {kDigit, kLetter, kBoolLetter, kSymbolChar, kSymbolTail,
+                   kMinus, kHash}) {
+        identifier[c] = kIdentifier;
+    }
+
+    table[kHashPrefix] = identifier;
+    table[kHashPrefix][kBoolLetter] = kBoolean;
+    table[kHashPrefix][kPipe] = kPipeBoolean;
+
+    // "#t" stays a boolean unless a word character glues it into a symbol.
+    for (auto c : {kDigit, kLetter, kBoolLetter}) {
+        table[kBoolean][c] = kIdentifier;
+    }
+
+    table[kSign][kDigit] = kInteger;
+    table[kInteger][kDigit] = kInteger;
+
+    return table;
+}
+
+constexpr std::array<TokenType, kLexStateCount> MakeAccepting() {
+    std::array<TokenType, kLexStateCount> accepting{};
+    accepting.fill(TokenType::None);
+
+    accepting[kIdentifier] = TokenType::Symbol;
+    accepting[kHashPrefix] = TokenType::Symbol;
+    accepting[kSign] = TokenType::Symbol;
+    accepting[kBoolean] = TokenType::Boolean;
+    accepting[kPipeBoolean] = TokenType::Boolean;
+    accepting[kInteger] = TokenType::Constant;
+    accepting[kQuoteChar] = TokenType::Quote;
+    accepting[kDotChar] = TokenType::Dot;
+    accepting[kOpenChar] = TokenType::OpenBracket;
+    accepting[kCloseChar] = TokenType::CloseBracket;
+
+    return accepting;
+}
+
+constexpr auto kCharClasses = MakeCharClasses();
+constexpr auto kTransitions = MakeTransitions();
+constexpr auto kAccepting = MakeAccepting();
+
+inline LexState Step(LexState state, char symb) {
+    return kTransitions[state][kCharClasses[static_cast<uint8_t>(symb)]];
+}
+
+// An optional sign and digits; literals beyond int64_t are kept as text for
+// the parser to make a bignum of.
+ConstantToken ParseConstant(std::string_view str) {
+    if (!str.empty() && str.front() == '+') {
+        str.remove_prefix(1);
+    }
+
+    int64_t value = 0;
+    const char *last = str.data() + str.size();
+    auto [end, error] = std::from_chars(str.data(), last, value);
+
+    if (error == std::errc::result_out_of_range) {
+        return {0, std::string{str}};
+    }
+    if (error != std::errc{} || end != last) {
+        throw SyntaxError{"Invalid constant"};
+    }
+
+    return {value, {}};
+}
+
+} // namespace
+
+TokenType DefineType(std::string_view str) {
+    LexState state = kStart;
+
+    for (char c : str) {
+        state = Step(state, c);
+    }
+
+    return kAccepting[state];
+}
+
+std::optional<TokenSpan> ScanToken(std::string_view source, size_t position) {
+    const size_t size = source.size();
+
+    while (position != size && Step(kStart, source[position]) == kDead) {
+        ++position;
+    }
+
+    if (position == size) {
+        return std::nullopt;
+    }
+
+    const size_t begin = position;
+    LexState state = kStart;
+
+    while (position != size) {
+        LexState next_state = Step(state, source[position]);
+
+        if (next_state == kDead) {
+            break;
         }
+
+        state = next_state;
+        ++position;
     }
 
-    return TokenType::None;
+    return TokenSpan{begin, position, kAccepting[state]};
 }
 
 TokenType GetType(const Token &token) {
@@ -39,10 +240,21 @@ TokenType GetType(const Token &token) {
     return TokenType::None;
 }
 
-Token *CreateToken(TokenType type, const std::string &str) {
+SymbolId GetSymbolId(const Token &token) {
+    if (const SymbolToken *p = std::get_if<SymbolToken>(&token)) {
+        return p->id;
+    }
+    if (std::holds_alternative<QuoteToken>(token)) {
+        return kQuoteSymbol;
+    }
+
+    throw RuntimeError{"Non-symbol token cannot be evaluated"};
+}
+
+Token *CreateToken(TokenType type, std::string_view str) {
     switch (type) {
     case TokenType::Symbol:
-        return new Token{SymbolToken{str}};
+        return new Token{SymbolToken{SymbolTable::Instance().Intern(str)}};
     case TokenType::Quote:
         return new Token{QuoteToken{}};
     case TokenType::Dot:
@@ -52,7 +264,7 @@ Token *CreateToken(TokenType type, const std::string &str) {
     case TokenType::CloseBracket:
         return new Token{BracketToken::CLOSE};
     case TokenType::Constant:
-        return new Token{ConstantToken{std::stoi(str)}};
+        return new Token{ParseConstant(str)};
     case TokenType::Boolean:
         return new Token{BooleanToken{str == "#t"}};
     case TokenType::None:
@@ -62,10 +274,10 @@ Token *CreateToken(TokenType type, const std::string &str) {
     throw SyntaxError{"Unkown token"};
 }
 
-Tokenizer::Tokenizer(std::istream *in) : input_stream_(in) { Next(); };
+Tokenizer::Tokenizer(std::string_view source) : source_(source) { Next(); };
 
 bool SymbolToken::operator==(const SymbolToken &other) const {
-    return name == other.name;
+    return id == other.id;
 }
 
 const std::string QuoteToken::kName = "quote";
@@ -75,15 +287,16 @@ bool QuoteToken::operator==(const QuoteToken &) const { return true; }
 bool DotToken::operator==(const DotToken &) const { return true; }
 
 bool ConstantToken::operator==(const ConstantToken &other) const {
-    return value == other.value;
+    return value == other.value && digits == other.digits;
 }
 
 bool BooleanToken::operator==(const BooleanToken &other) const {
     return value == other.value;
 }
 
-void Tokenizer::Update(std::istream *in) {
-    input_stream_ = in;
+void Tokenizer::Update(std::string_view source) {
+    source_ = source;
+    position_ = 0;
     Reset();
     Next();
 }
@@ -91,45 +304,25 @@ void Tokenizer::Update(std::istream *in) {
 bool Tokenizer::IsEnd() { return !current_token_.get(); }
 
 void Tokenizer::Next() {
-    TokenType current_token_type;
-    std::string current_token_string;
-
-    while (true) {
-        auto symb = input_stream_->peek();
-        current_token_string.push_back(symb);
-
-        TokenType defined_type = DefineType(current_token_string);
-
-        if (symb != std::char_traits<char>::eof() &&
-            defined_type != TokenType::None) {
-            input_stream_->get();
-            current_token_type = defined_type;
-            continue;
-        }
+    auto span = ScanToken(source_, position_);
 
-        current_token_string.pop_back();
+    if (!span) {
+        position_ = source_.size();
+        current_token_.reset(nullptr);
+        return;
+    }
 
-        if (current_token_string.empty()) {
-            if (symb == std::char_traits<char>::eof()) {
-                current_token_.reset(nullptr);
-                return;
-            }
+    position_ = span->end;
 
-            input_stream_->get();
-            continue;
-        }
-
-        if (current_token_type == TokenType::OpenBracket) {
-            ++opened_;
-        }
-        if (current_token_type == TokenType::CloseBracket) {
-            --opened_;
-        }
-
-        current_token_.reset(
-            CreateToken(current_token_type, current_token_string));
-        break;
+    if (span->type == TokenType::OpenBracket) {
+        ++opened_;
     }
+    if (span->type == TokenType::CloseBracket) {
+        --opened_;
+    }
+
+    current_token_.reset(CreateToken(
+        span->type, source_.substr(span->begin, span->end - span->begin)));
 }
 
 void Tokenizer::Reset() { opened_ = 0; }
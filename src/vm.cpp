@@ -0,0 +1,674 @@
+#include "utils/vm.h"
+#include "utils/base_object.h"
+#include "utils/bytecode.h"
+#include "utils/error.h"
+#include "utils/evaluator.h"
+#include "utils/globals.h"
+#include "utils/heap.h"
+#include "utils/object.h"
+#include "utils/profiler.h"
+#include "utils/symbol_table.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+
+namespace {
+
+// Slow path of the fixed arity opcodes: the operands are not fixnums.
+Object::NodeType ApplyBuiltin(SymbolId id, const Object::NodeType *args,
+                              size_t argc) {
+    return GetEvaluator(id)->Apply({args, argc});
+}
+
+void Link(Code *code, const void *const *handlers) {
+    auto &threaded = code->GetThreaded();
+
+    if (!threaded.empty() && code->GetThreadedTable() == handlers) {
+        return;
+    }
+
+    const auto &bytecode = code->GetBytecode();
+    threaded.clear();
+    threaded.reserve(bytecode.size());
+    code->SetThreadedTable(handlers);
+
+    for (size_t i = 0; i != bytecode.size();) {
+        uint32_t opcode = bytecode[i++];
+        threaded.push_back(reinterpret_cast<uintptr_t>(handlers[opcode]));
+
+        for (size_t k = 0; k != kOperandCount[opcode]; ++k) {
+            threaded.push_back(bytecode[i++]);
+        }
+    }
+}
+
+// Checks the argument count of a call and collects the rest argument into
+// a list.
+void BindArguments(const Code *code, Object::NodeType *args, size_t argc) {
+    size_t required = code->GetRequired();
+
+    if (argc < required || (argc > required && !code->HasRest())) {
+        throw RuntimeError{"Wrong number of arguments"};
+    }
+    if (!code->HasRest()) {
+        return;
+    }
+
+    Object::NodeType rest = nullptr;
+    for (size_t i = argc; i-- != required;) {
+        auto cell = Make<Cell>();
+        As<Cell>(cell)->SetFirst(args[i]);
+        As<Cell>(cell)->SetSecond(rest);
+        rest = cell;
+    }
+    args[required] = rest;
+}
+
+// Applies the builtin below the arguments, the result replaces it. Returns
+// the new top of the stack.
+Object::NodeType *ApplyPrimitive(Object::NodeType *sp, size_t argc) {
+    auto primitive = As<Primitive>(sp[-argc - 1]);
+
+    if (!primitive) {
+        throw RuntimeError{"Not callable object"};
+    }
+
+    auto result = primitive->GetEvaluator()->Apply({sp - argc, argc});
+    sp -= argc;
+    sp[-1] = result;
+
+    return sp;
+}
+
+[[noreturn]] void ThrowUnbound(Globals &globals, uint32_t slot) {
+    throw NameError{
+        "Unbound variable: " +
+        std::string{SymbolTable::Instance().GetName(globals.GetName(slot))}};
+}
+
+} // namespace
+
+VM::VM(Heap &heap, Globals &globals, Profiler &profiler)
+    : heap_(heap), globals_(globals), profiler_(profiler) {
+    heap_.AddRoots(this);
+}
+
+VM::~VM() { heap_.RemoveRoots(this); }
+
+void VM::TraceRoots(Tracer &tracer) {
+    if (live_ == 0) {
+        return;
+    }
+
+    for (size_t i = 0; i != live_; ++i) {
+        tracer.Visit(stack_[i]);
+    }
+
+    // the frames keep plain pointers, the objects may move
+    auto visit = [&tracer](Frame &frame) {
+        Object::NodeType code = frame.code;
+        Object::NodeType closure = frame.closure;
+
+        tracer.Visit(code);
+        tracer.Visit(closure);
+        frame.code = As<Code>(code);
+        frame.closure = As<Closure>(closure);
+    };
+
+    for (auto &frame : frames_) {
+        visit(frame);
+    }
+    visit(current_);
+}
+
+// Needs the labels as values extension of GCC and Clang.
+Object::NodeType VM::Execute(Code *code) {
+    // in the order of Opcode
+    static const void *const kHandlers[] = {
+        &&Constant,
+        &&Pop,
+        &&Jump,
+        &&JumpIfFalse,
+        &&JumpIfFalseOrPop,
+        &&JumpIfTrueOrPop,
+        &&LocalRef,
+        &&LocalSet,
+        &&FreeRef,
+        &&GlobalRef,
+        &&GlobalSet,
+        &&GlobalDefine,
+        &&Box,
+        &&Unbox,
+        &&BoxSet,
+        &&MakeClosure,
+        &&Call,
+        &&TailCall,
+        &&Builtin,
+        &&Add,
+        &&Subtract,
+        &&Multiply,
+        &&Divide,
+        &&Equal,
+        &&Less,
+        &&LessEqual,
+        &&Greater,
+        &&GreaterEqual,
+        &&Car,
+        &&Cdr,
+        &&Cons,
+        &&Not,
+        &&IsNull,
+        &&IsPair,
+        &&Return};
+    static_assert(std::size(kHandlers) == kOpcodeCount);
+
+    // the same, counting the calls of builtins first
+    static const void *const kCountingHandlers[] = {
+        &&Constant,
+        &&Pop,
+        &&Jump,
+        &&JumpIfFalse,
+        &&JumpIfFalseOrPop,
+        &&JumpIfTrueOrPop,
+        &&LocalRef,
+        &&LocalSet,
+        &&FreeRef,
+        &&GlobalRef,
+        &&GlobalSet,
+        &&GlobalDefine,
+        &&Box,
+        &&Unbox,
+        &&BoxSet,
+        &&MakeClosure,
+        &&CountCall,
+        &&CountTailCall,
+        &&CountBuiltin,
+        &&CountAdd,
+        &&CountSubtract,
+        &&CountMultiply,
+        &&CountDivide,
+        &&CountEqual,
+        &&CountLess,
+        &&CountLessEqual,
+        &&CountGreater,
+        &&CountGreaterEqual,
+        &&CountCar,
+        &&CountCdr,
+        &&CountCons,
+        &&CountNot,
+        &&CountIsNull,
+        &&CountIsPair,
+        &&Return};
+    static_assert(std::size(kCountingHandlers) == kOpcodeCount);
+
+    const void *const *handlers =
+        profiler_.IsEnabled() ? kCountingHandlers : kHandlers;
+    uint64_t *calls = profiler_.GetCallCounts();
+
+    frames_.clear();
+
+    if (stack_.empty()) {
+        stack_.resize(kInitialStack);
+    }
+
+    // left by the previous query, a collection must not see it
+    stack_[0] = nullptr;
+
+    auto *globals = globals_.GetValues();
+    Closure *closure = nullptr;
+    const Object::NodeType *constants;
+    const uintptr_t *start;
+    const uintptr_t *pc;
+    Object::NodeType *base = stack_.data();
+    // the first slot stands for the callee of the outermost frame, a tail
+    // call there moves its callee into it
+    Object::NodeType *fp = base + 1;
+    Object::NodeType *sp;
+
+    // Runs the code with its frame at fp, the first used slots of which
+    // are taken by the arguments.
+    auto enter = [&](Code *target, size_t used) {
+        Link(target, handlers);
+
+        size_t offset = fp - base;
+        size_t needed = offset + std::max(used, target->GetFrameSize()) +
+                        target->GetMaxStack();
+
+        if (needed > stack_.size()) {
+            stack_.resize(std::max(needed, 2 * stack_.size()));
+            base = stack_.data();
+            fp = base + offset;
+        }
+
+        code = target;
+        constants = code->GetConstants().data();
+        start = code->GetThreaded().data();
+        pc = start;
+        sp = fp + code->GetFrameSize();
+
+        // the other locals may hold stale values until they are set
+        std::fill(fp + std::min(used, code->GetFrameSize()), sp, nullptr);
+    };
+
+    enter(code, 0);
+
+    // Handlers hold no values of their own where they call this, all the
+    // query uses is below sp, in the frames, in code and in closure.
+    auto safepoint = [&] {
+        if (!heap_.IsNurseryFull()) [[likely]] {
+            return;
+        }
+
+        live_ = sp - base;
+        current_ = {code, closure, pc, static_cast<size_t>(fp - base)};
+        heap_.Collect();
+        live_ = 0;
+
+        size_t offset = pc - start;
+        code = current_.code;
+        closure = current_.closure;
+        constants = code->GetConstants().data();
+        start = code->GetThreaded().data();
+        pc = start + offset;
+    };
+
+    // Replaces a call of apply by the call of its procedure, with the
+    // elements of the last argument spread on the stack. Returns the new
+    // argument count.
+    auto spread = [&](size_t argc) {
+        for (auto primitive = As<Primitive>(sp[-argc - 1]);
+             primitive && primitive->GetId() == kApplySymbol;
+             primitive = As<Primitive>(sp[-argc - 1])) {
+            if (argc < 2) {
+                throw RuntimeError{"Wrong arguments amount for apply"};
+            }
+
+            auto list = sp[-1];
+            size_t count = 0;
+
+            for (auto it = list; it; it = As<Cell>(it)->GetSecond()) {
+                if (!Is<Cell>(it)) {
+                    throw RuntimeError{"List expected"};
+                }
+                ++count;
+            }
+
+            size_t offset = sp - base;
+            size_t needed = offset + count;
+
+            if (needed > stack_.size()) {
+                size_t fp_offset = fp - base;
+
+                stack_.resize(std::max(needed, 2 * stack_.size()));
+                base = stack_.data();
+                fp = base + fp_offset;
+                sp = base + offset;
+            }
+
+            // the procedure takes the slot of apply, the list is replaced
+            // by its elements
+            std::copy(sp - argc, sp - 1, sp - argc - 1);
+            sp -= 2;
+
+            for (; list; list = As<Cell>(list)->GetSecond()) {
+                *sp++ = As<Cell>(list)->GetFirst();
+            }
+
+            argc = argc - 2 + count;
+        }
+
+        return argc;
+    };
+
+#define DISPATCH() goto *reinterpret_cast<const void *>(*pc++)
+
+    DISPATCH();
+
+Constant:
+    *sp++ = constants[*pc++];
+    DISPATCH();
+
+Pop:
+    --sp;
+    DISPATCH();
+
+Jump:
+    safepoint();
+    pc = start + *pc;
+    DISPATCH();
+
+JumpIfFalse:
+    if (IsTrue(*--sp)) {
+        ++pc;
+    } else {
+        pc = start + *pc;
+    }
+    DISPATCH();
+
+JumpIfFalseOrPop:
+    if (IsTrue(sp[-1])) {
+        --sp;
+        ++pc;
+    } else {
+        pc = start + *pc;
+    }
+    DISPATCH();
+
+JumpIfTrueOrPop:
+    if (IsTrue(sp[-1])) {
+        pc = start + *pc;
+    } else {
+        --sp;
+        ++pc;
+    }
+    DISPATCH();
+
+LocalRef:
+    *sp++ = fp[*pc++];
+    DISPATCH();
+
+LocalSet:
+    fp[*pc++] = *--sp;
+    DISPATCH();
+
+FreeRef:
+    *sp++ = closure->GetFree(*pc++);
+    DISPATCH();
+
+GlobalRef:
+    if (globals[*pc].IsUnbound()) {
+        ThrowUnbound(globals_, *pc);
+    }
+    *sp++ = globals[*pc++];
+    DISPATCH();
+
+GlobalSet:
+    if (globals[*pc].IsUnbound()) {
+        ThrowUnbound(globals_, *pc);
+    }
+    globals[*pc++] = *--sp;
+    DISPATCH();
+
+GlobalDefine:
+    if (globals[*pc].IsUnbound()) {
+        globals_.NoteDefinition();
+    }
+    globals[*pc++] = *--sp;
+    DISPATCH();
+
+Box: {
+    auto &slot = fp[*pc++];
+    slot = Make<::Box>(slot);
+    DISPATCH();
+}
+
+Unbox:
+    sp[-1] = As<::Box>(sp[-1])->Get();
+    DISPATCH();
+
+BoxSet:
+    As<::Box>(sp[-2])->Set(sp[-1]);
+    sp -= 2;
+    DISPATCH();
+
+MakeClosure: {
+    auto lambda = constants[*pc++];
+    size_t count = *pc++;
+    auto value = Make<Closure>(lambda, count);
+
+    for (size_t i = 0; i != count; ++i) {
+        As<Closure>(value)->SetFree(i, sp[i - count]);
+    }
+    sp -= count;
+    *sp++ = value;
+    DISPATCH();
+}
+
+Call: {
+    safepoint();
+    size_t argc = *pc++;
+    auto target = As<Closure>(sp[-argc - 1]);
+
+    if (!target) {
+        argc = spread(argc);
+        target = As<Closure>(sp[-argc - 1]);
+    }
+    if (!target) {
+        sp = ApplyPrimitive(sp, argc);
+        DISPATCH();
+    }
+    if (frames_.size() == kMaxFrames) {
+        throw RuntimeError{"Maximum recursion depth exceeded"};
+    }
+
+    frames_.push_back({code, closure, pc, static_cast<size_t>(fp - base)});
+    closure = target;
+    fp = sp - argc;
+    enter(target->GetCode(), argc);
+    BindArguments(code, fp, argc);
+    DISPATCH();
+}
+
+TailCall: {
+    safepoint();
+    size_t argc = *pc++;
+    auto target = As<Closure>(sp[-argc - 1]);
+
+    if (!target) {
+        argc = spread(argc);
+        target = As<Closure>(sp[-argc - 1]);
+    }
+    // a builtin takes no frame, the Return that follows hands its result
+    // to the caller
+    if (!target) {
+        sp = ApplyPrimitive(sp, argc);
+        DISPATCH();
+    }
+
+    std::copy(sp - argc - 1, sp, fp - 1);
+    closure = target;
+    enter(target->GetCode(), argc);
+    BindArguments(code, fp, argc);
+    DISPATCH();
+}
+
+Builtin: {
+    auto id = static_cast<SymbolId>(*pc++);
+    size_t argc = *pc++;
+
+    auto result = ApplyBuiltin(id, sp - argc, argc);
+    sp -= argc;
+    *sp++ = result;
+    DISPATCH();
+}
+
+Add:
+    if (sp[-2].IsFixnum() && sp[-1].IsFixnum()) {
+        sp[-2] = MakeInteger(sp[-2].GetFixnum() + sp[-1].GetFixnum());
+    } else {
+        sp[-2] = ApplyBuiltin(kPlusSymbol, sp - 2, 2);
+    }
+    --sp;
+    DISPATCH();
+
+Subtract:
+    if (sp[-2].IsFixnum() && sp[-1].IsFixnum()) {
+        sp[-2] = MakeInteger(sp[-2].GetFixnum() - sp[-1].GetFixnum());
+    } else {
+        sp[-2] = ApplyBuiltin(kMinusSymbol, sp - 2, 2);
+    }
+    --sp;
+    DISPATCH();
+
+Multiply: {
+    int64_t result;
+
+    if (sp[-2].IsFixnum() && sp[-1].IsFixnum() &&
+        !__builtin_mul_overflow(sp[-2].GetFixnum(), sp[-1].GetFixnum(),
+                                &result)) {
+        sp[-2] = MakeInteger(result);
+    } else {
+        sp[-2] = ApplyBuiltin(kMultiplySymbol, sp - 2, 2);
+    }
+    --sp;
+    DISPATCH();
+}
+
+Divide:
+    if (sp[-2].IsFixnum() && sp[-1].IsFixnum() && sp[-1].GetFixnum() != 0) {
+        sp[-2] = MakeInteger(sp[-2].GetFixnum() / sp[-1].GetFixnum());
+    } else {
+        sp[-2] = ApplyBuiltin(kDivideSymbol, sp - 2, 2);
+    }
+    --sp;
+    DISPATCH();
+
+Equal:
+    if (sp[-2].IsFixnum() && sp[-1].IsFixnum()) {
+        sp[-2] = Object::NodeType::Boolean(sp[-2].GetFixnum() ==
+                                           sp[-1].GetFixnum());
+    } else {
+        sp[-2] = ApplyBuiltin(kEqualSymbol, sp - 2, 2);
+    }
+    --sp;
+    DISPATCH();
+
+Less:
+    if (sp[-2].IsFixnum() && sp[-1].IsFixnum()) {
+        sp[-2] = Object::NodeType::Boolean(sp[-2].GetFixnum() <
+                                           sp[-1].GetFixnum());
+    } else {
+        sp[-2] = ApplyBuiltin(kLessSymbol, sp - 2, 2);
+    }
+    --sp;
+    DISPATCH();
+
+LessEqual:
+    if (sp[-2].IsFixnum() && sp[-1].IsFixnum()) {
+        sp[-2] = Object::NodeType::Boolean(sp[-2].GetFixnum() <=
+                                           sp[-1].GetFixnum());
+    } else {
+        sp[-2] = ApplyBuiltin(kLessEqualSymbol, sp - 2, 2);
+    }
+    --sp;
+    DISPATCH();
+
+Greater:
+    if (sp[-2].IsFixnum() && sp[-1].IsFixnum()) {
+        sp[-2] = Object::NodeType::Boolean(sp[-2].GetFixnum() >
+                                           sp[-1].GetFixnum());
+    } else {
+        sp[-2] = ApplyBuiltin(kGreaterSymbol, sp - 2, 2);
+    }
+    --sp;
+    DISPATCH();
+
+GreaterEqual:
+    if (sp[-2].IsFixnum() && sp[-1].IsFixnum()) {
+        sp[-2] = Object::NodeType::Boolean(sp[-2].GetFixnum() >=
+                                           sp[-1].GetFixnum());
+    } else {
+        sp[-2] = ApplyBuiltin(kGreaterEqualSymbol, sp - 2, 2);
+    }
+    --sp;
+    DISPATCH();
+
+Car:
+    if (auto cell = As<Cell>(sp[-1])) {
+        sp[-1] = cell->GetFirst();
+    } else {
+        sp[-1] = ApplyBuiltin(kCarSymbol, sp - 1, 1);
+    }
+    DISPATCH();
+
+Cdr:
+    if (auto cell = As<Cell>(sp[-1])) {
+        sp[-1] = cell->GetSecond();
+    } else {
+        sp[-1] = ApplyBuiltin(kCdrSymbol, sp - 1, 1);
+    }
+    DISPATCH();
+
+Cons: {
+    auto cell = Make<Cell>();
+    As<Cell>(cell)->SetFirst(sp[-2]);
+    As<Cell>(cell)->SetSecond(sp[-1]);
+    sp[-2] = cell;
+    --sp;
+    DISPATCH();
+}
+
+Not:
+    sp[-1] = Object::NodeType::Boolean(!IsTrue(sp[-1]));
+    DISPATCH();
+
+IsNull:
+    sp[-1] = Object::NodeType::Boolean(sp[-1] == nullptr);
+    DISPATCH();
+
+IsPair:
+    sp[-1] = Object::NodeType::Boolean(Is<Cell>(sp[-1]));
+    DISPATCH();
+
+#define COUNT(opcode, id)                                                      \
+    Count##opcode:                                                             \
+    ++calls[id];                                                               \
+    goto opcode;
+
+    COUNT(Add, kPlusSymbol)
+    COUNT(Subtract, kMinusSymbol)
+    COUNT(Multiply, kMultiplySymbol)
+    COUNT(Divide, kDivideSymbol)
+    COUNT(Equal, kEqualSymbol)
+    COUNT(Less, kLessSymbol)
+    COUNT(LessEqual, kLessEqualSymbol)
+    COUNT(Greater, kGreaterSymbol)
+    COUNT(GreaterEqual, kGreaterEqualSymbol)
+    COUNT(Car, kCarSymbol)
+    COUNT(Cdr, kCdrSymbol)
+    COUNT(Cons, kConsSymbol)
+    COUNT(Not, kNotSymbol)
+    COUNT(IsNull, kNullPredicateSymbol)
+    COUNT(IsPair, kPairPredicateSymbol)
+    COUNT(Builtin, *pc)
+
+#undef COUNT
+
+CountCall:
+    if (auto primitive = As<Primitive>(sp[-*pc - 1])) {
+        ++calls[primitive->GetId()];
+    }
+    goto Call;
+
+CountTailCall:
+    if (auto primitive = As<Primitive>(sp[-*pc - 1])) {
+        ++calls[primitive->GetId()];
+    }
+    goto TailCall;
+
+Return: {
+    auto result = sp[-1];
+
+    if (frames_.empty()) {
+        return result;
+    }
+
+    const auto &frame = frames_.back();
+    fp[-1] = result;
+    sp = fp;
+
+    code = frame.code;
+    closure = frame.closure;
+    constants = code->GetConstants().data();
+    start = code->GetThreaded().data();
+    pc = frame.pc;
+    fp = base + frame.fp;
+    frames_.pop_back();
+    DISPATCH();
+}
+
+#undef DISPATCH
+}
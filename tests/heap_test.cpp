@@ -0,0 +1,40 @@
+#include "utils/heap.h"
+#include "utils/object.h"
+
+#include <iostream>
+
+namespace {
+
+bool Check(bool condition, const char *what) {
+    if (!condition) {
+        std::cerr << "Failed: " << what << '\n';
+    }
+
+    return condition;
+}
+
+} // namespace
+
+// The nursery fills up with the elements of the vectors allocated in it, not
+// only with their headers, and empties on a collection.
+int main() {
+    Heap heap;
+    size_t failures = 0;
+
+    {
+        Heap::Scope scope{&heap};
+
+        Make<Vector>(10, nullptr);
+        failures += !Check(!heap.IsNurseryFull(), "a small vector fits");
+
+        Make<Vector>(1 << 20, nullptr);
+        failures += !Check(heap.IsNurseryFull(), "a large vector fills it");
+
+        heap.Collect();
+        failures += !Check(!heap.IsNurseryFull(), "a collection empties it");
+        failures += !Check(heap.GetStats().nursery_bytes == 0,
+                           "nothing is left in it");
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+#include "utils/scheme.h"
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+namespace {
+
+std::string Repeat(const std::string &text, size_t count) {
+    std::string result;
+
+    for (size_t i = 0; i != count; ++i) {
+        result += text;
+    }
+
+    return result;
+}
+
+bool Check(Interpreter *interpreter, const std::string &query,
+           const std::string &expected, const char *what) {
+    std::string output;
+    interpreter->TryRun(query, &output);
+
+    if (output != expected) {
+        std::cerr << "Failed: " << what << ", got " << output.substr(0, 80)
+                  << '\n';
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+// Lists far longer than the stack would allow one frame per element, and
+// nesting deeper than the reader allows.
+int main() {
+    Interpreter interpreter;
+    size_t failures = 0;
+
+    failures += !Check(&interpreter,
+                       "(vector-length (list->vector '(" +
+                           Repeat("1 ", 200000) + ")))",
+                       "200000", "a long quoted list");
+    failures += !Check(&interpreter, "(+ " + Repeat("1 ", 200000) + ")",
+                       "200000", "a call with many arguments");
+    failures += !Check(&interpreter,
+                       "(vector-ref (list->vector '(" +
+                           Repeat("'a ", 100000) + ")) 99999)",
+                       "(quote a)", "a long list of quoted data");
+    failures += !Check(&interpreter, "'(1 2 . 3)", "(1 2 . 3)",
+                       "a dotted tail");
+    failures += !Check(&interpreter,
+                       "(car '" + Repeat("(", 5000) + "1" + Repeat(")", 5000) +
+                           ")",
+                       Repeat("(", 4999) + "1" + Repeat(")", 4999),
+                       "nesting within the limit");
+    failures += !Check(&interpreter,
+                       "(car '" + Repeat("(", 100000) + "1" +
+                           Repeat(")", 100000) + ")",
+                       "SyntaxError: Too deeply nested",
+                       "nesting beyond the limit");
+    failures += !Check(&interpreter, "(+ 1 2)", "3", "reading after an error");
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+#include "utils/reader.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr std::string_view kSource = "(define (square x)\n"
+                                     "  (* x x))\n"
+                                     "(square 12) 42 -17 +5 -\n"
+                                     "'(a (b . c) d) ''quoted\n"
+                                     "   (  +   1\t2 )#t #f abc-def?\n"
+                                     "(list 1\n"
+                                     "      (list 2 (list 3)))\n"
+                                     ") . 12345678901234567890 (unfinished";
+
+const std::vector<std::string> kData{"(define (square x)\n  (* x x))",
+                                     "(square 12)",
+                                     "42",
+                                     "-17",
+                                     "+5",
+                                     "-",
+                                     "'(a (b . c) d)",
+                                     "''quoted",
+                                     "(  +   1\t2 )",
+                                     "#t",
+                                     "#f",
+                                     "abc-def?",
+                                     "(list 1\n      (list 2 (list 3)))",
+                                     ")",
+                                     ".",
+                                     "12345678901234567890",
+                                     "(unfinished"};
+
+// Feeds the source cut at the given positions, the data are copied as they
+// come out since Feed invalidates them.
+std::vector<std::string> ReadData(const std::vector<size_t> &cuts) {
+    Reader reader;
+    std::vector<std::string> data;
+    size_t begin = 0;
+
+    auto drain = [&] {
+        while (auto datum = reader.Next()) {
+            data.emplace_back(*datum);
+        }
+    };
+
+    for (size_t end : cuts) {
+        reader.Feed(kSource.substr(begin, end - begin));
+        drain();
+        begin = end;
+    }
+
+    reader.Feed(kSource.substr(begin));
+    drain();
+    reader.Finish();
+    drain();
+
+    return data;
+}
+
+bool Check(const std::vector<size_t> &cuts) {
+    if (ReadData(cuts) == kData) {
+        return true;
+    }
+
+    std::cerr << "Read differently when cut at";
+    for (size_t cut : cuts) {
+        std::cerr << ' ' << cut;
+    }
+    std::cerr << '\n';
+
+    return false;
+}
+
+} // namespace
+
+// The data of a source do not depend on how it is cut into chunks: in one
+// piece, at every single position, one character at a time and at random
+// positions.
+int main() {
+    size_t failures = !Check({});
+    std::vector<size_t> every;
+
+    for (size_t i = 1; i < kSource.size(); ++i) {
+        failures += !Check({i});
+        every.push_back(i);
+    }
+
+    failures += !Check(every);
+
+    std::mt19937 random{42};
+    std::uniform_int_distribution<size_t> position{0, kSource.size()};
+    std::uniform_int_distribution<size_t> count{1, 16};
+
+    for (int i = 0; i != 10000; ++i) {
+        std::vector<size_t> cuts(count(random));
+
+        for (auto &cut : cuts) {
+            cut = position(random);
+        }
+        std::sort(cuts.begin(), cuts.end());
+
+        failures += !Check(cuts);
+    }
+
+    return failures == 0 ? 0 : 1;
+}
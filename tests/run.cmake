@@ -0,0 +1,34 @@
+# Runs the interpreter and compares what it prints, standard output and
+# errors merged, with an expected file:
+#   cmake -DSCHEME=path -DEXPECTED=file -DQUERIES=file -P run.cmake
+# runs every line of the file as a query of a fresh interpreter and prints
+# it after "$ " before its output, while
+#   cmake -DSCHEME=path -DEXPECTED=file -DSCRIPT=file [-DARGS=a;b] -P run.cmake
+# runs the script with the arguments.
+
+if(QUERIES)
+    set(actual "")
+    set(input "${CMAKE_CURRENT_BINARY_DIR}/query.scm")
+    file(STRINGS "${QUERIES}" lines)
+
+    foreach(line IN LISTS lines)
+        file(WRITE "${input}" "${line}\n")
+        execute_process(COMMAND "${SCHEME}"
+                        INPUT_FILE "${input}"
+                        OUTPUT_VARIABLE output
+                        ERROR_VARIABLE output)
+        string(APPEND actual "$ ${line}\n${output}")
+    endforeach()
+
+    file(REMOVE "${input}")
+else()
+    execute_process(COMMAND "${SCHEME}" ${ARGS} "${SCRIPT}"
+                    OUTPUT_VARIABLE actual
+                    ERROR_VARIABLE actual)
+endif()
+
+file(READ "${EXPECTED}" expected)
+
+if(NOT actual STREQUAL expected)
+    message(FATAL_ERROR "Unexpected output:\n${actual}")
+endif()
@@ -0,0 +1,30 @@
+(define base 100)
+(+ base 1)
+(+ base 2)
+(+ base 3)
+(begin (define more 5) (define twice (lambda (x) (* 2 x))))
+(+ base more)
+(twice more)
+(twice base)
+(set! base 1000)
+(+ base 1)
+(+ base 2)
+(begin (begin (define deep 7)))
+(list deep deep)
+(list 'define 1)
+(+ more 1)
+(define v (make-vector 3 0))
+(vector-set! v 0 5)
+(vector-ref v 0)
+(vector-ref v 0)
+(vector-ref v 0)
+(vector-ref v 0)
+(define (bump!) (vector-set! v 1 (+ 1 (vector-ref v 1))))
+(define (indirect) (bump!))
+(indirect)
+(indirect)
+(define fs (list indirect))
+((car fs))
+(vector-ref v 1)
+(vector-ref v 1)
+(+ 1 2)
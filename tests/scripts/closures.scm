@@ -0,0 +1,40 @@
+(define (make-counter)
+  (let ((n 0))
+    (lambda () (set! n (+ n 1)) n)))
+(define c1 (make-counter))
+(define c2 (make-counter))
+(c1)
+(c1)
+(c2)
+(list (c1) (c2))
+
+(define (adder k) (lambda (x) (+ x k)))
+((adder 5) 10)
+(define add3 (adder 3))
+(add3 (add3 1))
+
+(define (f . rest) rest)
+(f)
+(f 1 2 3)
+(define (g a . rest) (cons a rest))
+(g 1)
+(g 1 2)
+(g)
+
+(define (outer x)
+  (define y (* x 2))
+  (define (inner z) (+ y z))
+  (inner x))
+(outer 5)
+
+(let loop ((i 0) (acc '()))
+  (if (= i 5) acc (loop (+ i 1) (cons i acc))))
+(let loop ((a 1) (a 2)) a)
+((lambda (x x) x) 1 2)
+
+(define x 10)
+(begin (define x 20) (set! x (+ x 1)))
+x
+(set! undefined-variable 1)
+(let ((car 1)) car)
+(car '(1 2))
@@ -0,0 +1,10 @@
+(* 4611686018427387903 2)
+(+ 4611686018427387903 1)
+(- -4611686018427387904 1)
+(* 99999999999999999999 99999999999999999999)
+(/ 100000000000000000000 3)
+(< 100000000000000000000 100000000000000000001)
+(define (fact n) (if (= n 0) 1 (* n (fact (- n 1)))))
+(fact 30)
+(apply + (list 1 2 3 4 5 6 7 8 9 10))
+(apply max 1 2 '(30 4))
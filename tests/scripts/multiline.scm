@@ -0,0 +1,12 @@
+(+ 1
+   2)
+(+ 3 4) (+ 5 6)
+'(a
+  (b c)
+  d)
+(define
+  (square x)
+  (* x x)) (square 12)
+   42
+#t #f
+(list 'a 'b
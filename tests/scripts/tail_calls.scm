@@ -0,0 +1,24 @@
+(define (count n) (let loop ((i 0)) (if (= i n) i (loop (+ i 1)))))
+(count 1000000)
+
+(define (last-pair n)
+  (let loop ((i 0) (pair '()))
+    (if (= i n)
+        pair
+        (loop (+ i 1) (cons i i)))))
+(last-pair 3000000)
+
+(define (even? n) (if (= n 0) #t (odd? (- n 1))))
+(define (odd? n) (if (= n 0) #f (even? (- n 1))))
+(even? 100001)
+
+(define (sum-list l acc) (cond ((null? l) acc) (else (sum-list (cdr l) (+ acc (car l))))))
+(define (build n) (if (= n 0) '() (cons n (build (- n 1)))))
+(sum-list (build 100000) 0)
+
+(define (apply-loop n) (if (= n 0) 'done (apply apply-loop (list (- n 1)))))
+(apply-loop 100000)
+
+(define (deep n) (if (= n 0) 0 (+ 1 (deep (- n 1)))))
+(deep 100000)
+(deep 1000000)
@@ -0,0 +1,23 @@
+(define v (make-vector 3 0))
+v
+(vector-set! v 0 'a)
+(vector-set! v 2 (list 1 2))
+v
+(vector-ref v 2)
+(vector-length v)
+(vector-ref v 3)
+(vector->list (vector 1 2 3))
+(list->vector '(1 2 3))
+(vector)
+
+(define (fill! vec i)
+  (if (= i (vector-length vec))
+      vec
+      (begin (vector-set! vec i (* i i)) (fill! vec (+ i 1)))))
+(fill! (make-vector 10 #f) 0)
+
+(define (keep n)
+  (let loop ((i 0) (acc '()))
+    (if (= i n) acc (loop (+ i 1) (cons (make-vector 2 i) acc)))))
+(vector-ref (car (keep 200000)) 1)
+(make-vector 100000000000 0)
@@ -0,0 +1,168 @@
+#include "utils/error.h"
+#include "utils/server.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+int Connect(const std::string &path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.data(), path.size());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) !=
+        0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+void SendAll(int fd, const std::string &data) {
+    for (size_t sent = 0; sent != data.size();) {
+        ssize_t size = send(fd, data.data() + sent, data.size() - sent, 0);
+
+        if (size <= 0) {
+            return;
+        }
+        sent += size;
+    }
+}
+
+// Everything the server sends until it closes the connection.
+std::string ReceiveAll(int fd) {
+    std::string data;
+    char buffer[1 << 16];
+
+    for (ssize_t size; (size = recv(fd, buffer, sizeof(buffer), 0)) > 0;) {
+        data.append(buffer, size);
+    }
+
+    return data;
+}
+
+// Sends the queries, closes the sending side and reads all the responses.
+std::string Query(const std::string &path, const std::string &queries) {
+    int fd = Connect(path);
+
+    if (fd < 0) {
+        return "no connection";
+    }
+
+    SendAll(fd, queries);
+    shutdown(fd, SHUT_WR);
+
+    auto responses = ReceiveAll(fd);
+    close(fd);
+
+    return responses;
+}
+
+bool Check(bool condition, const char *what) {
+    if (!condition) {
+        std::cerr << "Failed: " << what << '\n';
+    }
+
+    return condition;
+}
+
+} // namespace
+
+// Pipelining past the limit of queued queries, a client that does not read
+// its responses, and two servers on one socket path.
+int main() {
+    std::string path =
+        "/tmp/scheme_server_test." + std::to_string(getpid()) + ".sock";
+    size_t failures = 0;
+
+    Server::Options options;
+    options.path = path;
+    options.workers = 2;
+
+    {
+        Server server{options};
+        std::thread thread{[&server] { server.Run(); }};
+
+        // all of them in a single write, many more than kMaxPipeline
+        std::string queries;
+        std::string expected;
+
+        for (int i = 0; i != 5000; ++i) {
+            queries += "(+ " + std::to_string(i) + " 1)\n";
+            expected += "> " + std::to_string(i + 1) + "\n";
+        }
+
+        failures += !Check(Query(path, queries) == expected,
+                           "pipelined queries are all answered in order");
+
+        // its responses pile up until the output limit, then it is no
+        // longer read, while other clients are still served
+        int greedy = Connect(path);
+        std::string large;
+
+        for (int i = 0; i != 1000; ++i) {
+            large += "(vector->list (make-vector 20000 7))\n";
+        }
+
+        std::thread sender{[greedy, &large] { SendAll(greedy, large); }};
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+        failures += !Check(Query(path, "(+ 1 2)\n") == "> 3\n",
+                           "a client that does not read blocks no one");
+
+        bool refused = false;
+
+        try {
+            Server second{options};
+        } catch (const RuntimeError &) {
+            refused = true;
+        }
+
+        failures += !Check(refused, "a live server keeps its socket");
+        failures += !Check(Query(path, "(+ 2 2)\n") == "> 4\n",
+                           "the live server still serves");
+
+        shutdown(greedy, SHUT_RDWR);
+        sender.join();
+        close(greedy);
+
+        server.Stop();
+        thread.join();
+    }
+
+    // the socket file of a server that is gone is taken over
+    int stale = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.data(), path.size());
+    bind(stale, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+    close(stale);
+
+    {
+        bool started = true;
+
+        try {
+            Server server{options};
+        } catch (const RuntimeError &) {
+            started = false;
+        }
+
+        failures += !Check(started, "a stale socket file is replaced");
+    }
+
+    unlink(path.c_str());
+
+    return failures == 0 ? 0 : 1;
+}
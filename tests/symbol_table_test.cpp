@@ -0,0 +1,54 @@
+#include "utils/error.h"
+#include "utils/scheme.h"
+#include "utils/symbol_table.h"
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+namespace {
+
+bool Check(bool condition, const char *what) {
+    if (!condition) {
+        std::cerr << "Failed: " << what << '\n';
+    }
+
+    return condition;
+}
+
+} // namespace
+
+// Fills the table up: new names are rejected from then on, the ones it
+// already has still work.
+int main() {
+    auto &table = SymbolTable::Instance();
+    Interpreter interpreter;
+    size_t failures = 0;
+    std::string output;
+
+    interpreter.TryRun("(define known 1)", &output);
+
+    bool full = false;
+    for (size_t i = 0; !full; ++i) {
+        try {
+            table.Intern("name" + std::to_string(i));
+        } catch (const RuntimeError &) {
+            full = true;
+        }
+    }
+
+    failures += !Check(table.Size() == SymbolTable::kMaxSymbols,
+                       "the table stops at kMaxSymbols");
+
+    interpreter.TryRun("(+ known 2)", &output);
+    failures += !Check(output == "3", "known names still work");
+
+    interpreter.TryRun("(define unknown 1)", &output);
+    failures += !Check(output == "RuntimeError: Too many symbols",
+                       "new names are rejected");
+
+    interpreter.TryRun("'name0", &output);
+    failures += !Check(output == "name0", "interned names are kept");
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+#include "utils/tokenizer.h"
+
+#include <cstddef>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// The token grammar as the regex lexer had it, in the order it tried them.
+const std::vector<std::pair<TokenType, std::regex>> kTokenRegexes{
+    {TokenType::Symbol,
+     std::regex{"(?!#(?:t|f)\\b)([a-zA-Z<=>\\*\\/#][a-zA-Z<=>\\*\\/"
+                "#0-9\\?\\!-]*|[\\+\\*\\/]|-(?=(\\D|$)))"}},
+    {TokenType::Quote, std::regex{"'"}},
+    {TokenType::Dot, std::regex{"\\."}},
+    {TokenType::OpenBracket, std::regex{"\\("}},
+    {TokenType::CloseBracket, std::regex{"\\)"}},
+    {TokenType::Constant, std::regex{"(-|\\+)?[\\d]+"}},
+    {TokenType::Boolean, std::regex{"#[t|f]"}}};
+
+constexpr std::string_view kAlphabet = "atfZ79#|-+*/<?!.'() _";
+
+TokenType MatchType(const std::string &text) {
+    for (const auto &[type, regex] : kTokenRegexes) {
+        if (std::regex_match(text, regex)) {
+            return type;
+        }
+    }
+
+    return TokenType::None;
+}
+
+// How the regex lexer cut the source: the longest prefix that still
+// matches, characters matching nothing skipped.
+std::vector<TokenSpan> ScanWithRegexes(std::string_view source) {
+    std::vector<TokenSpan> spans;
+    size_t position = 0;
+
+    while (position != source.size()) {
+        std::string text;
+        TokenType type = TokenType::None;
+        size_t end = position;
+
+        while (end != source.size()) {
+            text.push_back(source[end]);
+            auto next_type = MatchType(text);
+
+            if (next_type == TokenType::None) {
+                break;
+            }
+
+            type = next_type;
+            ++end;
+        }
+
+        if (end == position) {
+            ++position;
+        } else {
+            spans.push_back({position, end, type});
+            position = end;
+        }
+    }
+
+    return spans;
+}
+
+std::vector<TokenSpan> ScanWithDfa(std::string_view source) {
+    std::vector<TokenSpan> spans;
+
+    for (auto span = ScanToken(source, 0); span;
+         span = ScanToken(source, span->end)) {
+        spans.push_back(*span);
+    }
+
+    return spans;
+}
+
+bool Check(const std::string &source) {
+    auto expected = ScanWithRegexes(source);
+    auto actual = ScanWithDfa(source);
+    bool same = expected.size() == actual.size() &&
+                DefineType(source) == MatchType(source);
+
+    for (size_t i = 0; same && i != expected.size(); ++i) {
+        same = expected[i].begin == actual[i].begin &&
+               expected[i].end == actual[i].end &&
+               expected[i].type == actual[i].type;
+    }
+
+    if (!same) {
+        std::cerr << "Lexed differently: \"" << source << "\"\n";
+    }
+
+    return same;
+}
+
+} // namespace
+
+// Every string of up to three characters of the alphabet and random longer
+// ones are lexed by ScanToken and DefineType as the regexes lex them.
+int main() {
+    std::vector<std::string> sources{""};
+
+    for (size_t begin = 0, length = 0; length != 3; ++length) {
+        size_t end = sources.size();
+
+        for (size_t i = begin; i != end; ++i) {
+            for (char c : kAlphabet) {
+                sources.push_back(sources[i] + c);
+            }
+        }
+
+        begin = end;
+    }
+
+    std::mt19937 random{42};
+    std::uniform_int_distribution<size_t> length{4, 16};
+    std::uniform_int_distribution<size_t> index{0, kAlphabet.size() - 1};
+
+    for (int i = 0; i != 20000; ++i) {
+        std::string source(length(random), ' ');
+
+        for (char &c : source) {
+            c = kAlphabet[index(random)];
+        }
+
+        sources.push_back(std::move(source));
+    }
+
+    size_t failures = 0;
+
+    for (const auto &source : sources) {
+        failures += !Check(source);
+    }
+
+    return failures == 0 ? 0 : 1;
+}
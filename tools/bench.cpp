@@ -0,0 +1,310 @@
+// Benchmarks of the interpreter: micro ones for the tokenizer, the reader,
+// fasl files, heap images, every evaluator, the reduction kernels and the
+// printer, and whole queries on fresh interpreters. Prints JSON with the
+// wall time, the operator new calls and bytes per iteration and the peak
+// RSS of the process after each benchmark, and the instruction set of the
+// kernels.
+//
+//   scheme_bench [filter]
+//
+// runs the benchmarks whose names contain filter.
+
+#include "utils/base_object.h"
+#include "utils/evaluator.h"
+#include "utils/fasl.h"
+#include "utils/globals.h"
+#include "utils/heap.h"
+#include "utils/image.h"
+#include "utils/parser.h"
+#include "utils/printer.h"
+#include "utils/reductions.h"
+#include "utils/scheme.h"
+#include "utils/symbol_table.h"
+#include "utils/tokenizer.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/resource.h>
+
+namespace {
+
+size_t allocations = 0;
+size_t allocated_bytes = 0;
+
+} // namespace
+
+void *operator new(size_t size) {
+    ++allocations;
+    allocated_bytes += size;
+
+    if (void *memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+
+    throw std::bad_alloc{};
+}
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+
+void operator delete(void *memory, size_t) noexcept { std::free(memory); }
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr auto kMinTime = std::chrono::milliseconds{250};
+
+// Iterations between collections of the benchmark heap.
+constexpr size_t kBatch = 64;
+
+struct Benchmark {
+    std::string name;
+    std::function<void()> body;
+};
+
+size_t GetPeakRss() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return static_cast<size_t>(usage.ru_maxrss);
+}
+
+std::string Repeat(std::string_view text, size_t count) {
+    std::string result;
+
+    for (size_t i = 0; i < count; ++i) {
+        result += text;
+    }
+
+    return result;
+}
+
+// (0 1 ... count-1)
+std::string ListSource(size_t count) {
+    std::string result = "(";
+
+    for (size_t i = 0; i < count; ++i) {
+        result += std::to_string(i) + (i + 1 == count ? ")" : " ");
+    }
+
+    return result;
+}
+
+// (((...(x)...)))
+std::string NestedSource(size_t depth) {
+    return Repeat("(", depth) + "x" + Repeat(")", depth);
+}
+
+Object::NodeType Parse(std::string_view source) {
+    Tokenizer tokenizer{source};
+
+    return Read(&tokenizer);
+}
+
+// A fresh interpreter for every run, so reading and compiling are measured
+// along with the execution.
+void RunQueries(const std::vector<std::string> &queries) {
+    Interpreter interpreter;
+
+    for (const auto &query : queries) {
+        interpreter.Run(query);
+    }
+}
+
+void Measure(Heap &heap, const Benchmark &benchmark, bool first) {
+    size_t iterations = 0;
+    size_t start_allocations = allocations;
+    size_t start_bytes = allocated_bytes;
+    auto start = Clock::now();
+    auto elapsed = Clock::duration::zero();
+
+    while (elapsed < kMinTime) {
+        {
+            Heap::Scope scope{&heap};
+
+            for (size_t i = 0; i < kBatch; ++i) {
+                benchmark.body();
+            }
+        }
+
+        iterations += kBatch;
+        elapsed = Clock::now() - start;
+    }
+
+    double wall_ns =
+        std::chrono::duration<double, std::nano>(elapsed).count();
+
+    std::cout << (first ? "" : ",\n") << "    {\"name\": \""
+              << benchmark.name << "\", \"iterations\": " << iterations
+              << ", \"wall_ns\": " << wall_ns / iterations
+              << ", \"allocations\": "
+              << static_cast<double>(allocations - start_allocations) /
+                     iterations
+              << ", \"allocated_bytes\": "
+              << static_cast<double>(allocated_bytes - start_bytes) /
+                     iterations
+              << ", \"peak_rss_kb\": " << GetPeakRss() << "}";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string_view filter = argc > 1 ? argv[1] : "";
+
+    const std::string tokens = Repeat("(define (f x) (+ x 12 #t 'y)) ", 100);
+    const std::string list_source = ListSource(1000);
+    const std::string nested_source = NestedSource(500);
+
+    Heap heap;
+    Root list{heap};
+    Root nested{heap};
+    Root vector{heap};
+
+    // left before measuring, collections only happen in the outermost scope
+    {
+        Heap::Scope scope{&heap};
+
+        list.Set(Parse(list_source));
+        nested.Set(Parse(nested_source));
+        vector.Set(GetEvaluator(kListToVectorSymbol)->Apply({&list.Get(), 1}));
+    }
+
+    // the parsed sources as a load finds them in a fasl file
+    FaslWriter writer;
+    writer.Add(list.Get());
+    writer.Add(nested.Get());
+    const std::string fasl = writer.Finish(0, 0);
+
+    // the same data as the values of globals
+    Globals globals{heap};
+    auto define = [&globals](std::string_view name, const Root &root) {
+        auto slot = globals.GetSlot(SymbolTable::Instance().Intern(name));
+        globals.GetValues()[slot] = root.Get();
+    };
+    define("list", list);
+    define("nested", nested);
+    const std::string image = WriteImage(globals);
+
+    std::vector<Object::NodeType> numbers;
+    for (int64_t i = 1; i <= 8; ++i) {
+        numbers.push_back(Object::NodeType::Fixnum(i));
+    }
+
+    // long enough for the reduction kernels
+    std::vector<Object::NodeType> run;
+    for (int64_t i = 1; i <= 1000; ++i) {
+        run.push_back(Object::NodeType::Fixnum(i));
+    }
+
+    auto apply = [](SymbolId id, Evaluator::Arguments args) {
+        return [id, args] { GetEvaluator(id)->Apply(args); };
+    };
+    Printer printer;
+    auto print = [&printer](const Root &root) {
+        return [&printer, &root] {
+            printer.Clear();
+            printer.Print(root.Get());
+        };
+    };
+
+    const std::vector<Benchmark> benchmarks{
+        {"tokenizer/next",
+         [&] {
+             for (Tokenizer tokenizer{tokens}; !tokenizer.IsEnd();) {
+                 tokenizer.Next();
+             }
+         }},
+        {"reader/list", [&] { Parse(list_source); }},
+        {"reader/nested", [&] { Parse(nested_source); }},
+        {"fasl/encode",
+         [&] {
+             FaslWriter writer;
+             writer.Add(list.Get());
+             writer.Add(nested.Get());
+             writer.Finish(0, 0);
+         }},
+        {"fasl/decode",
+         [&] {
+             auto reader = FaslReader::Open(fasl, 0, 0);
+
+             while (reader->Next()) {
+             }
+         }},
+        {"image/write", [&] { WriteImage(globals); }},
+        {"image/read",
+         [&] {
+             Heap heap;
+             Globals restored{heap};
+
+             ReadImage(image, heap, &restored);
+         }},
+        {"evaluator/arithmetical", apply(kPlusSymbol, numbers)},
+        {"evaluator/comparator", apply(kLessSymbol, numbers)},
+        {"evaluator/predicator",
+         apply(kListPredicateSymbol, {&list.Get(), 1})},
+        {"evaluator/array_functor", apply(kMaxSymbol, numbers)},
+        {"evaluator/functor", apply(kAbsSymbol, {numbers.data(), 1})},
+        {"evaluator/logical", apply(kAndSymbol, numbers)},
+        {"evaluator/list_to_vector",
+         apply(kListToVectorSymbol, {&list.Get(), 1})},
+        {"evaluator/vector_to_list",
+         apply(kVectorToListSymbol, {&vector.Get(), 1})},
+        {"reduction/sum", apply(kPlusSymbol, run)},
+        {"reduction/max", apply(kMaxSymbol, run)},
+        {"reduction/less", apply(kLessSymbol, run)},
+        {"printer/list", print(list)},
+        {"printer/nested", print(nested)},
+        {"workload/long_list",
+         [] {
+             RunQueries({"(define (build n acc) (if (= n 0) acc "
+                         "(build (- n 1) (cons n acc))))",
+                         "(list-tail (build 10000 '()) 9999)"});
+         }},
+        {"workload/deep_nesting",
+         [] {
+             RunQueries({"(define x 1)", Repeat("(+ x ", 200) + "x" +
+                                             Repeat(")", 200)});
+         }},
+        {"workload/arithmetic",
+         [] {
+             RunQueries({"(define (fib n) (if (< n 2) n "
+                         "(+ (fib (- n 1)) (fib (- n 2)))))",
+                         "(fib 15)"});
+         }},
+        {"workload/apply",
+         [] {
+             RunQueries({"(define (build n acc) (if (= n 0) acc "
+                         "(build (- n 1) (cons n acc))))",
+                         "(define xs (build 10000 '()))",
+                         "(+ (apply + xs) (apply max xs))"});
+         }},
+        {"workload/bignum",
+         [] {
+             RunQueries({"(define (fact n) (if (= n 0) 1 "
+                         "(* n (fact (- n 1)))))",
+                         "(fact 200)"});
+         }},
+    };
+
+    std::cout << "{\n  \"reduction_isa\": \"" << GetReductionIsa()
+              << "\",\n  \"benchmarks\": [\n";
+
+    bool first = true;
+    for (const auto &benchmark : benchmarks) {
+        if (benchmark.name.find(filter) != std::string::npos) {
+            Measure(heap, benchmark, first);
+            first = false;
+        }
+    }
+
+    std::cout << "\n  ]\n}" << std::endl;
+}
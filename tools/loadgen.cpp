@@ -0,0 +1,251 @@
+// Load generator for scheme --listen: opens connections to the server,
+// keeps a number of pipelined queries in flight on each and reports the
+// throughput and the latency percentiles.
+//
+//   scheme_loadgen PORT|PATH [-c connections] [-n queries] [-d depth]
+//                  [-q query]
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string address;
+    size_t connections = 4;
+    size_t queries = 100000;
+    size_t depth = 16;
+    std::string query = "(+ 1 2)";
+};
+
+struct Report {
+    // nanoseconds from sending a query to reading its response
+    std::vector<int64_t> latencies;
+    size_t errors = 0;
+    bool failed = false;
+};
+
+int Connect(const std::string &address) {
+    uint16_t port;
+    auto [end, error] =
+        std::from_chars(address.data(), address.data() + address.size(), port);
+    int fd;
+
+    if (error == std::errc{} && end == address.data() + address.size()) {
+        sockaddr_in server{};
+        server.sin_family = AF_INET;
+        server.sin_port = htons(port);
+        server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr *>(&server),
+                               sizeof(server)) != 0) {
+            close(fd);
+            return -1;
+        }
+
+        int no_delay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+    } else {
+        sockaddr_un server{};
+        server.sun_family = AF_UNIX;
+
+        if (address.size() >= sizeof(server.sun_path)) {
+            return -1;
+        }
+        std::memcpy(server.sun_path, address.data(), address.size());
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr *>(&server),
+                               sizeof(server)) != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+
+    return fd;
+}
+
+bool SendAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        ssize_t size = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+
+        if (size <= 0) {
+            return false;
+        }
+        data.remove_prefix(size);
+    }
+
+    return true;
+}
+
+// Sends count queries over one connection, at most depth of them
+// unanswered at a time.
+void Drive(const Options &options, size_t count, Report *report) {
+    int fd = Connect(options.address);
+
+    if (fd < 0) {
+        report->failed = true;
+        return;
+    }
+
+    const std::string line = options.query + '\n';
+    std::deque<Clock::time_point> sent;
+    std::string input;
+    char buffer[1 << 16];
+    size_t sent_count = 0;
+    size_t received = 0;
+
+    report->latencies.reserve(count);
+
+    while (received != count) {
+        // top the pipeline up with one write
+        std::string batch;
+        while (sent_count != count && sent.size() < options.depth) {
+            batch += line;
+            sent.push_back(Clock::now());
+            ++sent_count;
+        }
+        if (!batch.empty() && !SendAll(fd, batch)) {
+            report->failed = true;
+            break;
+        }
+
+        ssize_t size = read(fd, buffer, sizeof(buffer));
+        if (size <= 0) {
+            report->failed = true;
+            break;
+        }
+
+        auto now = Clock::now();
+        input.append(buffer, size);
+
+        size_t begin = 0;
+        for (size_t end; (end = input.find('\n', begin)) != input.npos;
+             begin = end + 1) {
+            if (input.compare(begin, 2, "! ") == 0) {
+                ++report->errors;
+            }
+
+            report->latencies.push_back(
+                std::chrono::nanoseconds{now - sent.front()}.count());
+            sent.pop_front();
+            ++received;
+        }
+        input.erase(0, begin);
+    }
+
+    close(fd);
+}
+
+bool ParseCount(const std::string &text, size_t *value) {
+    auto [end, error] =
+        std::from_chars(text.data(), text.data() + text.size(), *value);
+
+    return error == std::errc{} && end == text.data() + text.size() &&
+           *value != 0;
+}
+
+bool ParseOptions(int argc, char **argv, Options *options) {
+    if (argc < 2) {
+        return false;
+    }
+
+    options->address = argv[1];
+
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string_view flag = argv[i];
+        std::string value = argv[i + 1];
+
+        size_t *count = flag == "-c"   ? &options->connections
+                        : flag == "-n" ? &options->queries
+                        : flag == "-d" ? &options->depth
+                                       : nullptr;
+
+        if (flag == "-q") {
+            options->query = value;
+        } else if (!count || !ParseCount(value, count)) {
+            return false;
+        }
+    }
+
+    return argc % 2 == 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+
+    if (!ParseOptions(argc, argv, &options)) {
+        std::cerr << "usage: scheme_loadgen PORT|PATH [-c connections] "
+                     "[-n queries] [-d depth] [-q query]"
+                  << std::endl;
+        return 2;
+    }
+
+    std::vector<Report> reports(options.connections);
+    std::vector<std::thread> threads;
+    auto start = Clock::now();
+
+    for (size_t i = 0; i < options.connections; ++i) {
+        size_t count = options.queries / options.connections +
+                       (i < options.queries % options.connections);
+
+        threads.emplace_back(Drive, std::cref(options), count, &reports[i]);
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    double seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    std::vector<int64_t> latencies;
+    size_t errors = 0;
+
+    for (const auto &report : reports) {
+        if (report.failed) {
+            std::cerr << "Connection to " << options.address << " failed"
+                      << std::endl;
+            return 1;
+        }
+
+        latencies.insert(latencies.end(), report.latencies.begin(),
+                         report.latencies.end());
+        errors += report.errors;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+
+    auto percentile = [&](double fraction) {
+        size_t index = static_cast<size_t>(fraction * (latencies.size() - 1));
+        return latencies[index] / 1000.0;
+    };
+
+    std::cout << "queries:     " << latencies.size() << " (" << errors
+              << " errors)\n"
+              << "throughput:  " << latencies.size() / seconds << " q/s\n"
+              << "p50 latency: " << percentile(0.5) << " us\n"
+              << "p99 latency: " << percentile(0.99) << " us\n"
+              << "max latency: " << percentile(1.0) << " us\n";
+}
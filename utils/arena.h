@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+class Object;
+
+// Bump allocator for objects that die together, the nursery of the heap.
+// Objects are placed back to back into large chunks; Reset rewinds the
+// chunks and only runs the destructors of types that need finalization, so
+// nothing may point into the arena after that.
+class Arena {
+  public:
+    struct Stats {
+        size_t bytes = 0;
+        size_t chunks = 0;
+    };
+
+    Arena() = default;
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    ~Arena();
+
+    template <class T, class... Args> T *New(Args &&...args) {
+        void *memory = Allocate(sizeof(T), alignof(T));
+        T *object = new (memory) T(std::forward<Args>(args)...);
+
+        if constexpr (T::kNeedsFinalization) {
+            finalizers_.push_back(object);
+        }
+
+        return object;
+    }
+
+    void Reset();
+
+    Stats GetStats() const { return {bytes_, chunks_.size()}; }
+
+  private:
+    static constexpr size_t kMinChunkSize = 64 * 1024;
+
+    struct Chunk {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    void *Allocate(size_t size, size_t alignment);
+
+    std::vector<Chunk> chunks_;
+    size_t current_chunk_ = 0;
+    size_t offset_ = 0;
+    size_t bytes_ = 0;
+    std::vector<Object *> finalizers_;
+};
@@ -1,18 +1,156 @@
 #pragma once
 
-#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <utility>
 
-class Object : public std::enable_shared_from_this<Object> {
+class Heap;
+class Object;
+
+// One machine word holding either an immediate or a heap reference:
+//   ...1  fixnum, 63-bit two's complement shifted left by one
+//   .010  boolean, the value is kept in bit 3
+//   .110  the unbound marker of a variable that has no value yet
+//   .000  pointer to a garbage collected Object, 0 is the empty list
+// Values are plain words, copying one never touches the heap.
+class Value {
   public:
-    using NodeType = std::shared_ptr<Object>;
+    static constexpr int64_t kFixnumMin = INT64_MIN >> 1;
+    static constexpr int64_t kFixnumMax = INT64_MAX >> 1;
+
+    Value() = default;
+    Value(std::nullptr_t) {}
+    Value(Object *object) : bits_(reinterpret_cast<uint64_t>(object)) {}
+
+    static constexpr bool FitsFixnum(int64_t value) {
+        return value >= kFixnumMin && value <= kFixnumMax;
+    }
+
+    static Value Fixnum(int64_t value) {
+        return Value{(static_cast<uint64_t>(value) << 1) | kFixnumTag};
+    }
+
+    static Value Boolean(bool value) {
+        return Value{(static_cast<uint64_t>(value) << 3) | kBooleanTag};
+    }
+
+    static Value Unbound() { return Value{kUnboundTag}; }
+
+    bool IsNull() const { return bits_ == 0; }
+    bool IsFixnum() const { return bits_ & kFixnumTag; }
+    bool IsBoolean() const { return (bits_ & kTagMask) == kBooleanTag; }
+    bool IsUnbound() const { return bits_ == kUnboundTag; }
+    bool IsHeap() const { return bits_ != 0 && (bits_ & kTagMask) == 0; }
+
+    int64_t GetFixnum() const { return static_cast<int64_t>(bits_) >> 1; }
+    bool GetBoolean() const { return bits_ >> 3; }
+
+    // nullptr for immediates and the empty list.
+    Object *Get() const {
+        return (bits_ & kTagMask) ? nullptr : reinterpret_cast<Object *>(bits_);
+    }
+
+    Object *operator->() const { return Get(); }
+
+    explicit operator bool() const { return bits_ != 0; }
+
+    // Identity, not structural equality.
+    bool operator==(const Value &other) const { return bits_ == other.bits_; }
+    bool operator==(std::nullptr_t) const { return bits_ == 0; }
+
+  private:
+    static constexpr uint64_t kTagMask = 0x7;
+    static constexpr uint64_t kFixnumTag = 0x1;
+    static constexpr uint64_t kBooleanTag = 0x2;
+    static constexpr uint64_t kUnboundTag = 0x6;
+
+    explicit Value(uint64_t bits) : bits_(bits) {}
+
+    uint64_t bits_ = 0;
+};
+
+// Dynamic type of a heap object, kept in its header so type checks are a
+// single compare instead of a dynamic_cast.
+enum class ObjectType : uint8_t {
+    Number,
+    Symbol,
+    Reserved,
+    Null,
+    Cell,
+    Vector,
+    Primitive,
+    Code,
+    Closure,
+    Box
+};
+
+// Reports every Value field of an object to the collector.
+class Tracer {
+  public:
+    virtual void Visit(Value &slot) = 0;
+
+  protected:
+    ~Tracer() = default;
+};
+
+class Object {
+  public:
+    using NodeType = Value;
+
+    // Set by types owning memory outside of the GC heap, only those get
+    // their destructor run when they die in the nursery.
+    static constexpr bool kNeedsFinalization = false;
+
+    Object &operator=(const Object &) = delete;
 
     virtual ~Object() = default;
 
-    virtual bool Callable() const { return false; }
+    virtual void Trace(Tracer &) {}
+
+    // Bytes owned outside of the GC heap, counted against the budget of the
+    // old generation. Heap::Promote knows the type, so this is not virtual.
+    size_t GetExternalSize() const { return 0; }
+
+    ObjectType GetObjectType() const {
+        return static_cast<ObjectType>(header_ >> kTypeShift);
+    }
+
+    bool IsOld() const { return header_ & kOld; }
 
-    virtual std::shared_ptr<Object> Call(NodeType args = nullptr) = 0;
+  protected:
+    explicit Object(ObjectType type)
+        : header_(static_cast<uint64_t>(type) << kTypeShift) {}
+
+    // Objects are only copied by the collector, the copy starts young.
+    Object(const Object &other) : header_(other.header_ & kTypeMask) {}
+
+  private:
+    friend class Heap;
+
+    // Moves the object out of the nursery into the old generation.
+    virtual Object *Relocate(Heap &heap) = 0;
+
+    static constexpr uint64_t kForwarded = 1 << 0;
+    static constexpr uint64_t kOld = 1 << 1;
+    static constexpr uint64_t kMarked = 1 << 2;
+    static constexpr uint64_t kRemembered = 1 << 3;
+    static constexpr int kTypeShift = 8;
+    static constexpr uint64_t kTypeMask = uint64_t{0xff} << kTypeShift;
+
+    // GC flags and the ObjectType, or the new address tagged with
+    // kForwarded once the object was evacuated from the nursery.
+    uint64_t header_;
+};
+
+// Gives a concrete type its type tag, T::kType, and its relocation hook,
+// defined in heap.h.
+template <class T> class HeapObject : public Object {
+  protected:
+    HeapObject() : Object(T::kType) {}
 
   private:
-    friend std::ostream &operator<<(std::ostream &out,
-                                    std::shared_ptr<Object> obj);
-};
\ No newline at end of file
+    Object *Relocate(Heap &heap) override;
+};
+
+std::ostream &operator<<(std::ostream &out, const Value &obj);
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "scheme.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Runs a batch of top-level data on several threads, each with an
+// Interpreter of its own, and hands the results back in input order.
+//
+// Data that may change the globals are barriers: top-level definitions,
+// those in a top-level begin included, and data mentioning a name that may
+// mutate. Those are the builtins whose names end in !, set! among them,
+// the globals of images and, as found from the text of the data and of the
+// loaded files, every global mentioned in a datum along with such a name.
+// A barrier is run by every worker, after everything before it and before
+// everything after it, so every interpreter sees the same globals. The
+// other data are spread over the workers; a worker that runs out of its
+// share steals from the others.
+class BatchRunner {
+  public:
+    struct Result {
+        // the printed value, or the kind and the message of the error
+        std::string output;
+        bool failed = false;
+    };
+
+    explicit BatchRunner(size_t workers);
+
+    BatchRunner(const BatchRunner &) = delete;
+    BatchRunner &operator=(const BatchRunner &) = delete;
+
+    ~BatchRunner();
+
+    std::vector<Result> Run(const std::vector<std::string_view> &data);
+
+    // Loads the file into every interpreter, see Interpreter::Load.
+    void Load(const std::string &path);
+
+    // Restores the image into every interpreter, see Interpreter::LoadImage.
+    void LoadImage(const std::string &path);
+
+    size_t GetWorkerCount() const;
+
+  private:
+    struct Worker;
+    struct Batch;
+
+    void Work(size_t index, Batch &batch);
+
+    // Another worker's datum, or false when all of them are done.
+    bool Steal(size_t thief, size_t *datum);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    // the data of the loaded files, scanned along with those of a batch
+    std::vector<std::string> loaded_;
+    // the globals of the images, whose code is not scanned
+    std::vector<std::string> opaque_;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <compare>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Arbitrary precision integer: a sign and the magnitude in 32-bit limbs,
+// least significant first, without leading zero limbs, so every value has
+// exactly one representation and zero is positive.
+class BigInt {
+  public:
+    BigInt() = default;
+    explicit BigInt(int64_t value);
+
+    // Decimal digits with an optional sign.
+    static BigInt Parse(std::string_view str);
+
+    std::optional<int64_t> ToInt64() const;
+
+    std::string ToString() const;
+
+    bool IsZero() const;
+    bool IsNegative() const;
+
+    BigInt operator-() const;
+
+    friend BigInt operator+(const BigInt &lhs, const BigInt &rhs);
+    friend BigInt operator-(const BigInt &lhs, const BigInt &rhs);
+    friend BigInt operator*(const BigInt &lhs, const BigInt &rhs);
+
+    // Truncates towards zero like int64_t division, rhs must not be zero.
+    friend BigInt operator/(const BigInt &lhs, const BigInt &rhs);
+
+    friend std::strong_ordering operator<=>(const BigInt &lhs,
+                                            const BigInt &rhs);
+    friend bool operator==(const BigInt &lhs, const BigInt &rhs) = default;
+
+  private:
+    using Limbs = std::vector<uint32_t>;
+
+    BigInt(bool negative, Limbs magnitude);
+
+    bool negative_ = false;
+    Limbs magnitude_;
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "base_object.h"
+#include "symbol_table.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Instructions of the stack VM. Operands follow their opcode in the
+// instruction stream, one word each.
+enum class Opcode : uint32_t {
+    Constant,         // index: push constants[index]
+    Pop,              // drop the top of the stack
+    Jump,             // target
+    JumpIfFalse,      // target: pop the top, jump if it is #f
+    JumpIfFalseOrPop, // target: jump if the top is #f, pop it otherwise
+    JumpIfTrueOrPop,  // target: jump unless the top is #f, pop it otherwise
+    LocalRef,         // slot: push the local variable of the frame
+    LocalSet,         // slot: pop into the local variable
+    FreeRef,          // index: push the captured variable of the closure
+    GlobalRef,        // slot: push the global, unbound ones are an error
+    GlobalSet,        // slot: pop into the global, it has to be bound
+    GlobalDefine,     // slot: pop into the global
+    Box,              // slot: wrap the local variable into a Box
+    Unbox,            // replace the box on the top with its value
+    BoxSet,           // pop a value and then the box to store it in
+    MakeClosure,      // index, count: close constants[index] over the values
+                      // on the top
+    Call,             // argc: apply the procedure below the arguments
+    TailCall,         // argc: the same, replacing the frame of the caller
+    Builtin,          // symbol id, argc: apply the builtin with this name
+    Add,              // the rest are builtins with a fixed arity
+    Subtract,
+    Multiply,
+    Divide,
+    Equal,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual,
+    Car,
+    Cdr,
+    Cons,
+    Not,
+    IsNull,
+    IsPair,
+    Return
+};
+
+constexpr size_t kOpcodeCount = static_cast<size_t>(Opcode::Return) + 1;
+
+// Number of operand words following each opcode.
+constexpr std::array<uint8_t, kOpcodeCount> kOperandCount{
+    1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 2, 1, 1, 2,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+// Compiled form of one expression or lambda body: the instruction stream and
+// the constants it refers to by index. Parameters and the other locals of a
+// procedure occupy the first GetFrameSize() slots of its frame.
+class Code : public HeapObject<Code> {
+  public:
+    static constexpr ObjectType kType = ObjectType::Code;
+    static constexpr bool kNeedsFinalization = true;
+
+    Code();
+
+    // Appends a word and returns its position.
+    size_t Emit(uint32_t word);
+
+    void Patch(size_t position, uint32_t word);
+
+    // Drops the words emitted after the first size ones.
+    void Truncate(size_t size);
+
+    size_t GetSize() const;
+    size_t GetExternalSize() const;
+
+    uint32_t AddConstant(Object::NodeType constant);
+
+    const std::vector<uint32_t> &GetBytecode() const;
+
+    const std::vector<Object::NodeType> &GetConstants() const;
+
+    size_t GetMaxStack() const;
+    void SetMaxStack(size_t size);
+
+    size_t GetFrameSize() const;
+    void SetFrameSize(size_t size);
+
+    // Arguments bound to parameters; with a rest parameter the others are
+    // collected into a list in the next slot.
+    size_t GetRequired() const;
+    bool HasRest() const;
+    void SetParameters(size_t required, bool rest);
+
+    // Name of the procedure when it was defined with one, for printing.
+    std::optional<SymbolId> GetName() const;
+    void SetName(SymbolId name);
+
+    // Handler addresses in place of the opcodes, filled by the VM when the
+    // code is first executed with a given table of handlers.
+    std::vector<uintptr_t> &GetThreaded();
+    const void *GetThreadedTable() const;
+    void SetThreadedTable(const void *table);
+
+    virtual void Trace(Tracer &tracer) override;
+
+  private:
+    // enough for a typical query to be compiled without regrowing
+    static constexpr size_t kInitialWords = 64;
+    static constexpr size_t kInitialConstants = 16;
+
+    std::vector<uint32_t> bytecode_;
+    std::vector<Object::NodeType> constants_;
+    std::vector<uintptr_t> threaded_;
+    const void *threaded_table_ = nullptr;
+    size_t max_stack_ = 0;
+    size_t frame_size_ = 0;
+    size_t required_ = 0;
+    bool rest_ = false;
+    std::optional<SymbolId> name_;
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "base_object.h"
+#include "globals.h"
+
+#include <cstddef>
+
+struct CompileStats {
+    // expression nodes replaced by constants or dropped as dead code
+    size_t folded_nodes = 0;
+};
+
+// Translates an expression returned by Read into a Code object. Variables
+// are resolved here: locals to frame slots, free variables of a lambda to
+// slots of its closure and the rest to slots of the globals. Calls of pure
+// builtins on constants are folded. Syntax errors, e.g. a malformed quote,
+// are reported before anything runs.
+Object::NodeType Compile(Object::NodeType expression, Globals &globals,
+                         CompileStats *stats);
@@ -1,48 +1,30 @@
 #pragma once
 
 #include "base_object.h"
+#include "symbol_table.h"
 #include "tokenizer.h"
 
-#include <map>
-#include <memory>
-#include <regex>
-
-enum class EvalCategory {
-    Predicator,
-    Comparator,
-    Arithmetical,
-    Logical,
-    ArrayFunctor,
-    Functor,
-    Quote,
-    None
-};
-
-const std::map<EvalCategory, std::regex> kEvalCategoriesRegexes{
-    {EvalCategory::Predicator, std::regex{"[a-z]+\\?"}},
-    {EvalCategory::Comparator, std::regex{"(=|<=|>=|<|>)"}},
-    {EvalCategory::Arithmetical, std::regex{"(\\+|-|\\*|/)"}},
-    {EvalCategory::Logical, std::regex{"(and|or|not)"}},
-    {EvalCategory::ArrayFunctor,
-     std::regex{"(min|max|cons|car|cdr|list|list-ref|list-tail)"}},
-    {EvalCategory::Functor, std::regex{"(abs)"}},
-    {EvalCategory::Quote, std::regex{"quote"}},
-};
+#include <span>
 
+// Implementation of a builtin procedure, applied to already evaluated
+// arguments.
 class Evaluator {
   public:
+    using Arguments = std::span<const Object::NodeType>;
+
     virtual ~Evaluator() = default;
 
-    virtual Object::NodeType Evaluate(Object::NodeType args) = 0;
+    virtual Object::NodeType Apply(Arguments args) const = 0;
 };
 
 class Arithmetical : public Evaluator {
   public:
     enum class ArithmeticalOperations { Plus, Minus, Multiply, Divide };
 
-    Arithmetical(const std::string &symbol);
+    constexpr explicit Arithmetical(ArithmeticalOperations type)
+        : type_(type) {}
 
-    virtual Object::NodeType Evaluate(Object::NodeType args) override;
+    virtual Object::NodeType Apply(Arguments args) const override;
 
   private:
     ArithmeticalOperations type_;
@@ -52,9 +34,9 @@ class Predicator : public Evaluator {
   public:
     enum class PredicateTypes { Integer, Boolean, Pair, List, Null };
 
-    Predicator(const std::string &type);
+    constexpr explicit Predicator(PredicateTypes type) : type_(type) {}
 
-    virtual Object::NodeType Evaluate(Object::NodeType args) override;
+    virtual Object::NodeType Apply(Arguments args) const override;
 
   private:
     PredicateTypes type_;
@@ -64,9 +46,9 @@ class Comparator : public Evaluator {
   public:
     enum class CompareType { EQ, LE, GE, LS, GR };
 
-    Comparator(const std::string &type);
+    constexpr explicit Comparator(CompareType type) : type_(type) {}
 
-    virtual Object::NodeType Evaluate(Object::NodeType args) override;
+    virtual Object::NodeType Apply(Arguments args) const override;
 
   private:
     CompareType type_;
@@ -85,21 +67,41 @@ class ArrayFunctor : public Evaluator {
         List_Tail
     };
 
-    ArrayFunctor(const std::string &type);
+    constexpr explicit ArrayFunctor(ArrayFunction type) : type_(type) {}
 
-    virtual Object::NodeType Evaluate(Object::NodeType args) override;
+    virtual Object::NodeType Apply(Arguments args) const override;
 
   private:
     ArrayFunction type_;
 };
 
+class VectorFunctor : public Evaluator {
+  public:
+    enum class VectorFunction {
+        Make,
+        Vector,
+        Ref,
+        Set,
+        Length,
+        ToList,
+        FromList
+    };
+
+    constexpr explicit VectorFunctor(VectorFunction type) : type_(type) {}
+
+    virtual Object::NodeType Apply(Arguments args) const override;
+
+  private:
+    VectorFunction type_;
+};
+
 class Functor : public Evaluator {
   public:
     enum class Function { Abs };
 
-    Functor(const std::string &type);
+    constexpr explicit Functor(Function type) : type_(type) {}
 
-    virtual Object::NodeType Evaluate(Object::NodeType args) override;
+    virtual Object::NodeType Apply(Arguments args) const override;
 
   private:
     Function type_;
@@ -109,21 +111,30 @@ class Logical : public Evaluator {
   public:
     enum class LogicalOperation { And, Or, Not };
 
-    Logical(const std::string &type);
+    constexpr explicit Logical(LogicalOperation type) : type_(type) {}
 
-    virtual Object::NodeType Evaluate(Object::NodeType args) override;
+    virtual Object::NodeType Apply(Arguments args) const override;
 
   private:
     LogicalOperation type_;
 };
 
-class Quote : public Evaluator {
+// (runtime-stats): an association list of what the profiler of the running
+// interpreter has collected.
+class RuntimeStats : public Evaluator {
   public:
-    Quote() = default;
-
-    virtual Object::NodeType Evaluate(Object::NodeType args) override;
+    virtual Object::NodeType Apply(Arguments args) const override;
 };
 
-EvalCategory DefineCategory(const std::string &symbol);
+// (apply f a ... list) calls f with a ... and the elements of list. The VM
+// spreads the arguments itself, so that closures can be applied too; this
+// one serves the other callers and applies builtins only.
+class Applicator : public Evaluator {
+  public:
+    virtual Object::NodeType Apply(Arguments args) const override;
+};
 
-std::unique_ptr<Evaluator> GetEvaluator(const Token &token);
\ No newline at end of file
+// Builtins are looked up by the id of their well-known symbol. Evaluators
+// are stateless, one shared instance serves every occurrence of a name.
+// Special forms such as quote have no evaluator.
+const Evaluator *GetEvaluator(SymbolId id);
\ No newline at end of file
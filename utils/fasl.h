@@ -0,0 +1,67 @@
+#pragma once
+
+#include "base_object.h"
+#include "symbol_table.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Fast load files: the parsed data of a source file in a compact binary
+// form, kept next to it as <path>.fasl so that loading it again needs no
+// lexing or parsing. The file is tied to the source by the size and a hash
+// of its content, a changed source makes it stale.
+//
+// The form holds no pointers, symbols are names in a table that are
+// interned when the file is opened. Every datum is a program of a tiny
+// stack machine, in postfix order: atoms push a value, a list or a vector
+// pops its elements, so decoding needs neither recursion nor a parser.
+
+uint64_t HashContent(std::string_view content);
+
+// Replaces the file at path at once, a reader sees the old or the new one.
+// False when it cannot be written, e.g. in a read-only directory.
+bool WriteFileAtomically(const std::string &path, std::string_view content);
+
+class FaslWriter {
+  public:
+    // False when the datum holds a value that has no fasl form, e.g. the
+    // reserved tokens of a malformed datum.
+    bool Add(const Value &datum);
+
+    // The whole file.
+    std::string Finish(uint64_t source_hash, uint64_t source_size) const;
+
+  private:
+    void Encode(const Value &datum);
+    uint32_t GetSymbolIndex(SymbolId id);
+
+    std::string code_;
+    std::vector<SymbolId> symbols_;
+    // index in symbols_ plus one by symbol id, 0 when not there yet
+    std::vector<uint32_t> symbol_indices_;
+    uint32_t count_ = 0;
+    bool valid_ = true;
+};
+
+class FaslReader {
+  public:
+    // nullopt unless the file is well formed and made of this source.
+    static std::optional<FaslReader> Open(std::string_view file,
+                                          uint64_t source_hash,
+                                          uint64_t source_size);
+
+    // Decodes the next datum on the current heap, nullopt at the end.
+    std::optional<Value> Next();
+
+  private:
+    FaslReader() = default;
+
+    std::string_view code_;
+    size_t position_ = 0;
+    std::vector<SymbolId> symbols_;
+    std::vector<Value> stack_;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "base_object.h"
+#include "heap.h"
+#include "symbol_table.h"
+
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// Top-level bindings of an interpreter. A name gets a dense slot when code
+// referring to it is compiled, so the VM reaches globals by index; the slot
+// holds the unbound marker until the name is defined.
+class Globals {
+  public:
+    explicit Globals(Heap &heap);
+
+    Globals(const Globals &) = delete;
+    Globals &operator=(const Globals &) = delete;
+
+    ~Globals();
+
+    uint32_t GetSlot(SymbolId name);
+
+    std::optional<uint32_t> FindSlot(SymbolId name) const;
+
+    // True once a value was defined for the name.
+    bool IsDefined(SymbolId name) const;
+
+    SymbolId GetName(uint32_t slot) const;
+
+    uint32_t GetSlotCount() const;
+
+    // Changes whenever a name gets defined for the first time, which is when
+    // code referring to it may compile differently.
+    uint64_t GetVersion() const;
+
+    // Called by the VM before it defines an unbound name.
+    void NoteDefinition();
+
+    // Stable while no new slot is created, i.e. while code is running.
+    Object::NodeType *GetValues();
+
+  private:
+    Heap &heap_;
+    std::unordered_map<SymbolId, uint32_t> slots_;
+    std::vector<SymbolId> names_;
+    std::vector<Object::NodeType> values_;
+    uint64_t version_ = 0;
+};
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "arena.h"
+#include "base_object.h"
+#include "error.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Generational tracing collector. New objects are bump allocated in the
+// nursery; a minor collection evacuates the ones reachable from the roots
+// into the old generation and rewinds the nursery, the old generation is
+// mark-swept once it outgrows its budget. Nothing scans the C++ stack, so
+// collections only happen at query boundaries (see Heap::Scope) and at the
+// safepoints of the VM, where every value of the running query is on its
+// stack; values kept across queries have to be registered as roots.
+class Heap {
+  public:
+    // Makes the heap current for Make<T> on this thread. Leaving the
+    // outermost scope of a heap runs a collection.
+    class Scope {
+      public:
+        explicit Scope(Heap *heap);
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+        ~Scope();
+
+      private:
+        Heap *heap_;
+        Heap *previous_;
+    };
+
+    // Roots kept in a structure of their own, e.g. the stack of the VM.
+    class RootSet {
+      public:
+        virtual void TraceRoots(Tracer &tracer) = 0;
+
+      protected:
+        ~RootSet() = default;
+    };
+
+    struct Stats {
+        size_t minor_collections = 0;
+        size_t major_collections = 0;
+        uint64_t total_pause_ns = 0;
+        uint64_t max_pause_ns = 0;
+        uint64_t last_pause_ns = 0;
+        size_t promoted_bytes = 0;
+        size_t nursery_bytes = 0;
+        size_t old_bytes = 0;
+        size_t old_objects = 0;
+    };
+
+    Heap() = default;
+
+    Heap(const Heap &) = delete;
+    Heap &operator=(const Heap &) = delete;
+
+    ~Heap();
+
+    static Heap *Current();
+
+    template <class T, class... Args> T *New(Args &&...args) {
+        T *object = nursery_.New<T>(std::forward<Args>(args)...);
+        nursery_external_ += object->GetExternalSize();
+        return object;
+    }
+
+    template <class T> T *Promote(T &&object) {
+        T *copy = new T(std::move(object));
+        size_t size = sizeof(T) + copy->GetExternalSize();
+        copy->header_ |= Object::kOld;
+        old_objects_.push_back({copy, size});
+        old_bytes_ += size;
+        return copy;
+    }
+
+    void AddRoot(Value *root);
+    void RemoveRoot(Value *root);
+
+    // Every element of the vector is a root, the vector may grow meanwhile.
+    void AddRoots(std::vector<Value> *roots);
+    void RemoveRoots(std::vector<Value> *roots);
+
+    void AddRoots(RootSet *roots);
+    void RemoveRoots(RootSet *roots);
+
+    // Records an old object that was made to point into the nursery.
+    void WriteBarrier(Object *holder, const Value &value) {
+        if (holder->IsOld() && value.IsHeap() && !value->IsOld() &&
+            !(holder->header_ & Object::kRemembered)) {
+            holder->header_ |= Object::kRemembered;
+            remembered_.push_back(holder);
+        }
+    }
+
+    void Collect();
+    void CollectFull();
+
+    // Whether a query has allocated enough to collect at a safepoint, the
+    // elements of vectors and the like count as well as the arena.
+    bool IsNurseryFull() const {
+        return nursery_.GetStats().bytes + nursery_external_ >= kNurseryBudget;
+    }
+
+    // Budgets the old generation as if a major collection had just found
+    // all of it alive, e.g. after objects known to be live were promoted in
+    // bulk.
+    void ResetMajorThreshold();
+
+    Stats GetStats() const;
+
+  private:
+    static constexpr size_t kMinMajorThreshold = 1 << 20;
+    static constexpr size_t kNurseryBudget = 4 << 20;
+
+    struct OldObject {
+        Object *object;
+        size_t size;
+    };
+
+    class Evacuator;
+    class Marker;
+
+    void MinorCollection();
+    void MajorCollection();
+
+    Arena nursery_;
+    size_t nursery_external_ = 0;
+    std::vector<OldObject> old_objects_;
+    size_t old_bytes_ = 0;
+    size_t major_threshold_ = kMinMajorThreshold;
+    std::vector<Value *> roots_;
+    std::vector<std::vector<Value> *> root_vectors_;
+    std::vector<RootSet *> root_sets_;
+    std::vector<Object *> remembered_;
+    size_t scope_depth_ = 0;
+    Stats stats_;
+};
+
+// A value that stays alive, and gets updated when its object moves, as long
+// as the root exists. Roots are registered by address, so they don't move.
+class Root {
+  public:
+    Root(Heap &heap, Value value = nullptr) : heap_(heap), value_(value) {
+        heap_.AddRoot(&value_);
+    }
+
+    Root(const Root &) = delete;
+    Root &operator=(const Root &) = delete;
+
+    ~Root() { heap_.RemoveRoot(&value_); }
+
+    const Value &Get() const { return value_; }
+
+    void Set(Value value) { value_ = value; }
+
+  private:
+    Heap &heap_;
+    Value value_;
+};
+
+template <class T> Object *HeapObject<T>::Relocate(Heap &heap) {
+    return heap.Promote(std::move(static_cast<T &>(*this)));
+}
+
+template <class T, class... Args> Value Make(Args &&...args) {
+    Heap *heap = Heap::Current();
+
+    if (!heap) {
+        throw RuntimeError{"No active heap"};
+    }
+
+    return heap->New<T>(std::forward<Args>(args)...);
+}
+
+inline void WriteBarrier(Object *holder, const Value &value) {
+    if (holder->IsOld()) {
+        Heap::Current()->WriteBarrier(holder, value);
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "globals.h"
+#include "heap.h"
+
+#include <string>
+#include <string_view>
+
+// Heap images: the global variables of an interpreter and every object they
+// reach, so that a warmed up interpreter can be brought back without
+// running the code that built it.
+//
+// An image is position independent. Values keep the tags of Value, except
+// that a reference is the index of an object record shifted left by three;
+// symbols and global slots, which differ between processes and
+// interpreters, are indices in tables of names. Restoring maps the file,
+// allocates every object straight into the old generation and then fixes
+// the references up in a second pass over the records.
+
+// Everything reachable from the globals, throws RuntimeError when some of it
+// has no image form.
+std::string WriteImage(Globals &globals);
+
+// Defines the globals of the image, their names get slots as needed.
+// Throws RuntimeError for a malformed image, nothing is defined then.
+void ReadImage(std::string_view image, Heap &heap, Globals *globals);
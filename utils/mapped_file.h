@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Read-only memory mapping of a whole file. The mapping lives as long as the
+// object, so views handed out by GetView() must not outlive it.
+class MappedFile {
+  public:
+    explicit MappedFile(const std::string &path);
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile();
+
+    std::string_view GetView() const;
+
+  private:
+    void *data_ = nullptr;
+    size_t size_ = 0;
+};
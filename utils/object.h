@@ -1,102 +1,196 @@
 #pragma once
 
 #include "base_object.h"
+#include "bigint.h"
 #include "error.h"
 #include "evaluator.h"
+#include "heap.h"
+#include "symbol_table.h"
 #include "tokenizer.h"
 
+#include <compare>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
-class Number : public Object {
+// Integers outside of the fixnum range, everything else is an immediate.
+// MakeInteger keeps it that way, so equal integers have the same kind.
+class Number : public HeapObject<Number> {
   public:
-    Number(const Token &token) : token_(token) {}
+    static constexpr ObjectType kType = ObjectType::Number;
+    static constexpr bool kNeedsFinalization = true;
 
-    bool IsBoolean() const;
+    explicit Number(BigInt value) : value_(std::move(value)) {}
 
-    int64_t GetValue() const;
-
-    bool GetBooleanValue() const;
-
-    virtual Object::NodeType Call(Object::NodeType args) override;
+    const BigInt &GetValue() const;
 
   private:
-    Token token_;
+    BigInt value_;
 };
 
-class Symbol : public Object {
+class Symbol : public HeapObject<Symbol> {
   public:
-    Symbol(const Token &token) : token_(token), eval_(GetEvaluator(token)) {}
+    static constexpr ObjectType kType = ObjectType::Symbol;
 
-    const std::string &GetName() const;
+    Symbol(const Token &token) : id_(GetSymbolId(token)) {}
 
-    virtual bool Callable() const override;
+    SymbolId GetId() const;
 
-    virtual Object::NodeType Call(Object::NodeType args) override;
+    std::string_view GetName() const;
 
   private:
-    Token token_;
-    std::unique_ptr<Evaluator> eval_;
+    SymbolId id_;
 };
 
-class Reserved : public Object {
+class Reserved : public HeapObject<Reserved> {
   public:
+    static constexpr ObjectType kType = ObjectType::Reserved;
+
     Reserved(const Token &token) : token_(token) {}
 
-    TokenType GetType() const;
+    const Token &GetToken() const;
 
-    virtual Object::NodeType Call(Object::NodeType args) override;
+    TokenType GetType() const;
 
   private:
     Token token_;
 };
 
-class Null : public Object {
-  private:
-    virtual Object::NodeType Call(Object::NodeType) override {
-        throw RuntimeError{"Null cannot be evaluated"};
-    }
+class Null : public HeapObject<Null> {
+  public:
+    static constexpr ObjectType kType = ObjectType::Null;
 };
 
-class Cell : public Object {
+class Cell : public HeapObject<Cell> {
   public:
+    static constexpr ObjectType kType = ObjectType::Cell;
+
     void SetFirst(Object::NodeType other);
     void SetSecond(Object::NodeType other);
 
     Object::NodeType GetFirst() const;
     Object::NodeType GetSecond() const;
 
-    virtual Object::NodeType Call(Object::NodeType args) override;
+    virtual void Trace(Tracer &tracer) override;
 
   private:
     Object::NodeType left_;
     Object::NodeType right_;
 };
 
+// Fixed size array with O(1) indexing. The elements live outside of the GC
+// heap, so the storage has to be released when the vector dies young.
+class Vector : public HeapObject<Vector> {
+  public:
+    static constexpr ObjectType kType = ObjectType::Vector;
+    static constexpr bool kNeedsFinalization = true;
+
+    Vector(size_t size, Object::NodeType fill) : elements_(size, fill) {}
+
+    size_t GetSize() const;
+    size_t GetExternalSize() const;
+
+    Object::NodeType GetElement(size_t index) const;
+    void SetElement(size_t index, Object::NodeType value);
+
+    virtual void Trace(Tracer &tracer) override;
+
+  private:
+    std::vector<Object::NodeType> elements_;
+};
+
+// A builtin procedure as a first-class value, e.g. the result of evaluating
+// the symbol car.
+class Primitive : public HeapObject<Primitive> {
+  public:
+    static constexpr ObjectType kType = ObjectType::Primitive;
+
+    explicit Primitive(SymbolId id) : id_(id), eval_(::GetEvaluator(id)) {}
+
+    SymbolId GetId() const;
+
+    const Evaluator *GetEvaluator() const;
+
+  private:
+    SymbolId id_;
+    const Evaluator *eval_;
+};
+
+class Code;
+
+// A procedure made by lambda: its code and the values of the free variables
+// it captured, copied into a flat array when the closure was created.
+class Closure : public HeapObject<Closure> {
+  public:
+    static constexpr ObjectType kType = ObjectType::Closure;
+    static constexpr bool kNeedsFinalization = true;
+
+    Closure(Object::NodeType code, size_t free) : code_(code), free_(free) {}
+
+    Code *GetCode() const;
+
+    size_t GetFreeCount() const;
+    size_t GetExternalSize() const;
+    Object::NodeType GetFree(size_t index) const;
+    void SetFree(size_t index, Object::NodeType value);
+
+    virtual void Trace(Tracer &tracer) override;
+
+  private:
+    Object::NodeType code_;
+    std::vector<Object::NodeType> free_;
+};
+
+// Storage of a variable assigned with set!, shared by the frame declaring
+// it and the closures capturing it.
+class Box : public HeapObject<Box> {
+  public:
+    static constexpr ObjectType kType = ObjectType::Box;
+
+    explicit Box(Object::NodeType value) : value_(value) {}
+
+    Object::NodeType Get() const;
+    void Set(Object::NodeType value);
+
+    virtual void Trace(Tracer &tracer) override;
+
+  private:
+    Object::NodeType value_;
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 
 // Runtime type checking and conversion.
-// This can be helpful:
-// https://en.cppreference.com/w/cpp/memory/shared_ptr/pointer_cast
 
-template <class T> std::shared_ptr<T> As(const std::shared_ptr<Object> &obj) {
-    auto p = dynamic_cast<T *>(obj.get());
+template <class T> bool Is(const Object::NodeType &obj) {
+    return obj.IsHeap() && obj->GetObjectType() == T::kType;
+}
 
-    if (p) {
-        return std::shared_ptr<T>{obj, p};
-    }
-    return std::shared_ptr<T>{};
+template <class T> T *As(const Object::NodeType &obj) {
+    return Is<T>(obj) ? static_cast<T *>(obj.Get()) : nullptr;
 }
 
-template <class T> bool Is(const std::shared_ptr<Object> &obj) {
-    auto p = dynamic_cast<T *>(obj.get());
+Object::NodeType MakeInteger(int64_t value);
+Object::NodeType MakeInteger(BigInt value);
 
-    return p != nullptr;
-}
+bool IsInteger(const Object::NodeType &obj);
+
+bool IsBoolean(const Object::NodeType &obj);
+
+// Throws for integers beyond int64_t, e.g. when used as an index.
+int64_t GetInteger(const Object::NodeType &obj);
+
+BigInt GetBigInteger(const Object::NodeType &obj);
+
+// Both have to be integers.
+std::strong_ordering CompareIntegers(const Object::NodeType &lhs,
+                                     const Object::NodeType &rhs);
 
-void ToVector(Object::NodeType node, std::vector<Object::NodeType> &args);
+bool GetBoolean(const Object::NodeType &obj);
 
-Object::NodeType FromVector(size_t pos, std::vector<Object::NodeType> &args);
\ No newline at end of file
+// Truthiness: everything but #f counts as true.
+bool IsTrue(const Object::NodeType &obj);
@@ -9,8 +9,10 @@
 
 Object::NodeType ConvertNull(Object::NodeType obj);
 
-std::shared_ptr<Object> ReadToken(Tokenizer *tokenizer);
+Object::NodeType ReadQuoted(Tokenizer *tokenizer);
 
-std::shared_ptr<Object> Read(Tokenizer *tokenizer, bool first = true);
+Object::NodeType ReadToken(Tokenizer *tokenizer);
 
-std::shared_ptr<Object> ReadList(Tokenizer *tokenizer);
\ No newline at end of file
+Object::NodeType Read(Tokenizer *tokenizer, bool first = true);
+
+Object::NodeType ReadList(Tokenizer *tokenizer);
\ No newline at end of file
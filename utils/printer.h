@@ -0,0 +1,61 @@
+#pragma once
+
+#include "base_object.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Writes values in their external representation: (1 (2 3) . 4), #(1 2),
+// #t. Lists and vectors are walked with an explicit stack, so neither their
+// length nor their depth is bounded by the native stack. The buffer and the
+// stack are kept between calls.
+//
+// With a file descriptor the output is written to it whenever the buffer
+// fills up, so a huge result is never held in memory as a whole.
+class Printer {
+  public:
+    static constexpr size_t kBufferSize = 1 << 16;
+
+    // Keeps all of the output in the buffer.
+    Printer() = default;
+    explicit Printer(int fd);
+
+    Printer(const Printer &) = delete;
+    Printer &operator=(const Printer &) = delete;
+
+    // Writes out what is left, errors are ignored there.
+    ~Printer();
+
+    void Print(const Value &value);
+    void Write(std::string_view text);
+
+    // The output not written to the descriptor yet.
+    std::string_view GetView() const;
+    void Clear();
+
+    // Throws RuntimeError when the descriptor cannot be written.
+    void Flush();
+
+  private:
+    // What is left to print of a list or a vector entered.
+    struct Task {
+        enum class Kind { ListTail, VectorTail, Close };
+
+        Kind kind;
+        Value value;
+        size_t index = 0;
+    };
+
+    // Prints an atom, or opens a list or a vector and leaves its task.
+    void Enter(Value value);
+    void PrintAtom(const Value &value);
+    void WriteInteger(int64_t value);
+    void FlushIfFull();
+
+    int fd_ = -1;
+    std::string buffer_;
+    std::vector<Task> tasks_;
+};
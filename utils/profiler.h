@@ -0,0 +1,99 @@
+#pragma once
+
+#include "symbol_table.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Where the time of an interpreter goes: latency histograms of the phases
+// of every query and call counts of the builtins. It costs nothing while
+// disabled: the phases are only timed when enabled, and builtin calls are
+// counted by separate handlers that the VM links code with only then.
+class Profiler {
+  public:
+    // Reading covers tokenizing too, the reader pulls tokens as it goes.
+    enum class Phase { Read, Compile, Evaluate, Print };
+
+    static constexpr size_t kPhaseCount = 4;
+
+    static constexpr std::array<const char *, kPhaseCount> kPhaseNames{
+        "read", "compile", "evaluate", "print"};
+
+    // Log-bucketed: bucket i holds the latencies up to 2^(8 + i) ns, about
+    // 256 ns to 34 s, the last one the longer ones.
+    class Histogram {
+      public:
+        static constexpr size_t kBucketCount = 29;
+
+        static uint64_t GetBound(size_t bucket);
+
+        void Record(uint64_t ns);
+
+        uint64_t GetCount() const;
+        uint64_t GetSum() const;
+        uint64_t GetBucket(size_t bucket) const;
+
+      private:
+        static constexpr int kMinExponent = 8;
+
+        std::array<uint64_t, kBucketCount> buckets_{};
+        uint64_t count_ = 0;
+        uint64_t sum_ = 0;
+    };
+
+    // Times a phase when the profiler is enabled.
+    class Timer {
+      public:
+        Timer(Profiler &profiler, Phase phase);
+
+        Timer(const Timer &) = delete;
+        Timer &operator=(const Timer &) = delete;
+
+        ~Timer();
+
+      private:
+        Profiler &profiler_;
+        Phase phase_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    // Makes the profiler current on this thread, for (runtime-stats).
+    class Scope {
+      public:
+        explicit Scope(Profiler *profiler);
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+        ~Scope();
+
+      private:
+        Profiler *previous_;
+    };
+
+    static Profiler *Current();
+
+    bool IsEnabled() const;
+    void SetEnabled(bool enabled);
+
+    void CountQuery();
+    uint64_t GetQueryCount() const;
+
+    const Histogram &GetHistogram(Phase phase) const;
+
+    // Indexed by the id of the builtin, incremented by the VM.
+    uint64_t *GetCallCounts();
+    uint64_t GetCallCount(SymbolId id) const;
+
+    // OpenMetrics text exposition, terminated by # EOF.
+    void WriteOpenMetrics(std::ostream &out) const;
+
+  private:
+    bool enabled_ = false;
+    uint64_t queries_ = 0;
+    std::array<Histogram, kPhaseCount> phases_;
+    std::array<uint64_t, kWellKnownSymbolCount> calls_{};
+};
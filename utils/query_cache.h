@@ -0,0 +1,67 @@
+#pragma once
+
+#include "base_object.h"
+#include "heap.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Least recently used cache of compiled queries keyed by their text, so a
+// repeated query is neither parsed nor compiled again. How a query compiles
+// depends on which globals are defined, so every entry remembers the
+// version of the globals it was compiled against and goes stale once it
+// changes. Cached code is kept alive as a root.
+class QueryCache {
+  public:
+    static constexpr size_t kDefaultCapacity = 1024;
+
+    // Longer queries, e.g. whole files, are not worth keeping.
+    static constexpr size_t kMaxQueryLength = 4096;
+
+    struct Stats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t size = 0;
+    };
+
+    explicit QueryCache(Heap &heap, size_t capacity = kDefaultCapacity);
+
+    QueryCache(const QueryCache &) = delete;
+    QueryCache &operator=(const QueryCache &) = delete;
+
+    ~QueryCache();
+
+    // Returns nullptr and counts a miss unless the query was compiled
+    // against this version.
+    Object::NodeType Find(std::string_view query, uint64_t version);
+
+    void Insert(std::string_view query, Object::NodeType code,
+                uint64_t version);
+
+    Stats GetStats() const;
+
+  private:
+    struct Entry {
+        std::string query;
+        uint64_t version;
+        // index of the code in codes_
+        size_t slot;
+    };
+
+    void Erase(std::list<Entry>::iterator entry);
+
+    Heap &heap_;
+    size_t capacity_;
+    // most recently used first
+    std::list<Entry> entries_;
+    // keys point to the queries of entries_
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index_;
+    std::vector<Object::NodeType> codes_;
+    std::vector<size_t> free_slots_;
+    Stats stats_;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Cuts source text into top-level data, so that a script runs one datum at
+// a time however its lines are broken. The text may arrive in chunks, e.g.
+// from a pipe; a datum is handed out once it is complete.
+class Reader {
+  public:
+    void Feed(std::string_view text);
+
+    // Marks the end of the input: a trailing atom stops waiting for more
+    // characters and an unfinished datum is handed out as it is, for the
+    // parser to report.
+    void Finish();
+
+    // The text of the next datum, valid until the next Feed; nullopt when
+    // more input is needed.
+    std::optional<std::string_view> Next();
+
+  private:
+    std::string buffer_;
+    // beginning of the datum being read
+    size_t start_ = 0;
+    // where scanning for its end stopped
+    size_t position_ = 0;
+    size_t depth_ = 0;
+    bool in_datum_ = false;
+    bool finished_ = false;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "base_object.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+// Reductions over runs of values, e.g. the arguments of a builtin, that
+// work on the words themselves while every value is a fixnum. The order of
+// the tagged words is the order of the fixnums, so only the sum untags
+// them. The kernels use AVX2 or SSE4.2 when the CPU has them, the choice
+// is made on the first call, and give the same results as the scalar ones.
+//
+// Every reduction fails when a value is not a fixnum, the caller takes its
+// generic path then.
+
+// Shorter runs are not worth it.
+constexpr size_t kMinReduction = 16;
+
+enum class Relation { Equal, Less, LessEqual, Greater, GreaterEqual };
+
+// Also fails when the sum or a partial one overflows int64_t, and in the
+// vector kernels when the partial sum of a lane leaves the fixnum range. A
+// sum that is returned is exact either way.
+std::optional<int64_t> SumFixnums(const Value *values, size_t count);
+
+// The least or the greatest value, count must not be 0.
+std::optional<Value> MinFixnum(const Value *values, size_t count);
+std::optional<Value> MaxFixnum(const Value *values, size_t count);
+
+// Whether every value is in the relation with the next one.
+std::optional<bool> CompareFixnums(const Value *values, size_t count,
+                                   Relation relation);
+
+// Name of the instruction set the kernels use: "avx2", "sse4.2" or
+// "scalar".
+const char *GetReductionIsa();
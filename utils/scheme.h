@@ -1,13 +1,84 @@
 #pragma once
 
+#include "base_object.h"
+#include "compiler.h"
+#include "globals.h"
+#include "heap.h"
+#include "printer.h"
+#include "profiler.h"
+#include "query_cache.h"
 #include "tokenizer.h"
+#include "vm.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 class Interpreter {
   public:
-    std::string Run(const std::string &query);
+    std::string Run(std::string_view query);
+
+    // Prints the result into printer instead, e.g. straight to a file.
+    void Run(std::string_view query, Printer *printer);
+
+    // Like Run, but an error is reported in output as "Kind: message"
+    // instead of being thrown. Returns false then.
+    bool TryRun(std::string_view query, std::string *output);
+    bool TryRun(std::string_view query, Printer *printer, std::string *error);
+
+    // Runs the top-level data of the file in order and returns the result
+    // of the last one.
+    std::string RunFile(const std::string &path);
+
+    // Like RunFile, but the data are parsed once and kept in path.fasl,
+    // later loads of the unchanged file read them from there. See fasl.h.
+    std::string Load(const std::string &path);
+
+    // Writes the globals and everything they refer to into an image at
+    // path, which LoadImage restores without running any code. See image.h.
+    void SaveImage(const std::string &path);
+    void LoadImage(const std::string &path);
+
+    // Unlike Run, hands the result out, alive as long as the root is.
+    Root Evaluate(std::string_view query);
+
+    // The names of the globals that have a value.
+    std::vector<SymbolId> GetDefinedGlobals() const;
+
+    Heap::Stats GetHeapStats() const;
+
+    CompileStats GetCompileStats() const;
+
+    QueryCache::Stats GetQueryCacheStats() const;
+
+    // Disabled by default, see Profiler.
+    void SetProfiling(bool enabled);
+    const Profiler &GetProfiler() const;
 
   private:
+    Object::NodeType EvaluateQuery(std::string_view query);
+    Object::NodeType CompileDatum(const Object::NodeType &ast);
+
+    // The fasl form of the source, nullopt when some datum cannot be read.
+    std::optional<std::string> BuildFasl(std::string_view source,
+                                         uint64_t hash);
+
+    // A collection scans every global, so a load collects once per batch
+    // of data rather than after each of them: leaves the scope and enters
+    // a new one when the nursery has grown past kLoadBatchBytes.
+    void RenewLoadScope(std::optional<Heap::Scope> *scope);
+
+    static constexpr size_t kLoadBatchBytes = 16 << 20;
+
+    Heap heap_;
+    Globals globals_{heap_};
     Tokenizer tokenizer_;
+    Profiler profiler_;
+    VM vm_{heap_, globals_, profiler_};
+    CompileStats compile_stats_;
+    QueryCache query_cache_{heap_};
+    Printer printer_;
 };
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "scheme.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Evaluation server. A client sends one query per line and gets one line
+// back per query, in order: "> " and the result, or "! " and the error.
+// Requests may be pipelined.
+//
+// A single thread does all the socket I/O with epoll; the queries run on a
+// pool of worker threads, each with an Interpreter constructed up front.
+// A connection sticks to one worker, so its queries run in order and see
+// each other's definitions, which connections sharing the worker see as
+// well.
+class Server {
+  public:
+    struct Options {
+        // a Unix domain socket when set, localhost TCP otherwise
+        std::string path;
+        uint16_t port = 0;
+        size_t workers = 1;
+        // restored by every worker first when set, see
+        // Interpreter::LoadImage
+        std::string image;
+        // loaded by every worker before serving, see Interpreter::Load
+        std::vector<std::string> preludes;
+    };
+
+    explicit Server(const Options &options);
+
+    Server(const Server &) = delete;
+    Server &operator=(const Server &) = delete;
+
+    ~Server();
+
+    // Serves until Stop is called.
+    void Run();
+
+    // Safe to call from another thread or a signal handler.
+    void Stop();
+
+  private:
+    // A connection stops being read while this many of its queries wait.
+    static constexpr size_t kMaxPipeline = 1024;
+    // Nor while this much output waits for the client.
+    static constexpr size_t kMaxOutput = 1 << 20;
+    static constexpr size_t kMaxLine = 1 << 20;
+    static constexpr size_t kReadSize = 1 << 16;
+
+    struct Request {
+        uint64_t connection;
+        std::string query;
+    };
+
+    struct Response {
+        uint64_t connection;
+        std::string line;
+    };
+
+    struct Worker {
+        Interpreter interpreter;
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<Request> requests;
+        std::thread thread;
+    };
+
+    struct Connection {
+        int fd;
+        size_t worker;
+        std::string input;
+        std::string output;
+        size_t pending = 0;
+        // epoll events currently requested
+        uint32_t events = 0;
+        bool eof = false;
+    };
+
+    void Listen(const Options &options);
+
+    void Work(Worker *worker);
+
+    void Accept();
+    void Read(uint64_t id, Connection *connection);
+    // Queues the complete lines of the input, up to the pipeline limit and
+    // unless the output is over its limit.
+    void Dispatch(uint64_t id, Connection *connection);
+    // Dispatches the lines held back once some of the output is written.
+    void Write(uint64_t id, Connection *connection);
+    void DeliverResponses();
+
+    // Requests the events the state of the connection calls for, or closes
+    // it once it is done.
+    void Update(uint64_t id, Connection *connection);
+    void Close(uint64_t id);
+
+    // Closes the listening socket, the epoll and the event descriptors.
+    void CloseDescriptors();
+
+    std::string path_;
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    // wakes the I/O thread for responses and for Stop
+    int event_fd_ = -1;
+    std::atomic<bool> stopping_ = false;
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::unordered_map<uint64_t, Connection> connections_;
+    uint64_t next_id_;
+    size_t next_worker_ = 0;
+
+    std::mutex responses_mutex_;
+    std::vector<Response> responses_;
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+using SymbolId = uint32_t;
+
+// Names interned by the table itself, their ids are fixed and dense, so
+// per-name data (e.g. builtins) can be kept in plain arrays indexed by id.
+enum WellKnownSymbol : SymbolId {
+    kQuoteSymbol,
+    kPlusSymbol,
+    kMinusSymbol,
+    kMultiplySymbol,
+    kDivideSymbol,
+    kEqualSymbol,
+    kLessEqualSymbol,
+    kGreaterEqualSymbol,
+    kLessSymbol,
+    kGreaterSymbol,
+    kNumberPredicateSymbol,
+    kBooleanPredicateSymbol,
+    kPairPredicateSymbol,
+    kListPredicateSymbol,
+    kNullPredicateSymbol,
+    kAndSymbol,
+    kOrSymbol,
+    kNotSymbol,
+    kMinSymbol,
+    kMaxSymbol,
+    kConsSymbol,
+    kCarSymbol,
+    kCdrSymbol,
+    kListSymbol,
+    kListRefSymbol,
+    kListTailSymbol,
+    kAbsSymbol,
+    kMakeVectorSymbol,
+    kVectorSymbol,
+    kVectorRefSymbol,
+    kVectorSetSymbol,
+    kVectorLengthSymbol,
+    kVectorToListSymbol,
+    kListToVectorSymbol,
+    kRuntimeStatsSymbol,
+    kApplySymbol,
+    kDefineSymbol,
+    kLambdaSymbol,
+    kLetSymbol,
+    kSetSymbol,
+    kIfSymbol,
+    kCondSymbol,
+    kElseSymbol,
+    kBeginSymbol,
+    kWellKnownSymbolCount
+};
+
+constexpr std::array<std::string_view, kWellKnownSymbolCount>
+    kWellKnownNames{"quote",     "+",        "-",     "*",     "/",
+                    "=",         "<=",       ">=",    "<",     ">",
+                    "number?",   "boolean?", "pair?", "list?", "null?",
+                    "and",       "or",       "not",   "min",   "max",
+                    "cons",      "car",      "cdr",   "list",  "list-ref",
+                    "list-tail", "abs",
+                    "make-vector",  "vector",        "vector-ref",
+                    "vector-set!",  "vector-length", "vector->list",
+                    "list->vector", "runtime-stats", "apply",
+                    "define",       "lambda",        "let",
+                    "set!",         "if",            "cond",
+                    "else",         "begin"};
+
+// Process-wide interning table: every distinct symbol name is stored once
+// and identified by a small integer, so symbol equality is an id compare.
+// Names are never released, views returned by GetName stay valid forever.
+// Ids are shared by all interpreters, images and fasl files of the process,
+// so instead of scoping names per interpreter the table is capped: once it
+// holds kMaxSymbols names or kMaxSymbolBytes of them, Intern rejects new
+// names with RuntimeError, while known ones keep working. This bounds what
+// clients of a long-running server can make it keep.
+class SymbolTable {
+  public:
+    static constexpr size_t kMaxSymbols = 1 << 20;
+    static constexpr size_t kMaxSymbolBytes = 64 << 20;
+
+    static SymbolTable &Instance();
+
+    SymbolTable(const SymbolTable &) = delete;
+    SymbolTable &operator=(const SymbolTable &) = delete;
+
+    SymbolId Intern(std::string_view name);
+
+    std::string_view GetName(SymbolId id) const;
+
+    size_t Size() const;
+
+  private:
+    SymbolTable();
+
+    mutable std::shared_mutex mutex_;
+    std::deque<std::string> names_;
+    size_t bytes_ = 0;
+    std::unordered_map<std::string_view, SymbolId> ids_;
+};
@@ -1,13 +1,17 @@
 #pragma once
 
-#include <istream>
-#include <map>
+#include "symbol_table.h"
+
+#include <cstddef>
+#include <cstdint>
 #include <memory>
-#include <regex>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <variant>
 
 struct SymbolToken {
-    std::string name;
+    SymbolId id;
 
     bool operator==(const SymbolToken &other) const;
 };
@@ -26,6 +30,8 @@ enum class BracketToken { OPEN, CLOSE };
 
 struct ConstantToken {
     int64_t value;
+    // The literal itself when it doesn't fit into value.
+    std::string digits;
 
     bool operator==(const ConstantToken &other) const;
 };
@@ -50,28 +56,29 @@ enum class TokenType {
 using Token = std::variant<ConstantToken, BooleanToken, BracketToken,
                            SymbolToken, QuoteToken, DotToken>;
 
-const std::map<TokenType, std::regex> kTokenRegexes{
-    {TokenType::Constant, std::regex{"(-|\\+)?[\\d]+"}},
-    {TokenType::Boolean, std::regex{"#[t|f]"}},
-    {TokenType::Symbol,
-     std::regex{"(?!#(?:t|f)\\b)([a-zA-Z<=>\\*\\/#][a-zA-Z<=>\\*\\/"
-                "#0-9\\?\\!-]*|[\\+\\*\\/]|-(?=(\\D|$)))"}},
-    {TokenType::Quote, std::regex{"'"}},
-    {TokenType::Dot, std::regex{"\\."}},
-    {TokenType::OpenBracket, std::regex{"\\("}},
-    {TokenType::CloseBracket, std::regex{"\\)"}}};
+TokenType DefineType(std::string_view str);
+
+struct TokenSpan {
+    size_t begin;
+    size_t end;
+    TokenType type;
+};
 
-TokenType DefineType(const std::string &str);
+// Bounds of the first token of source at or after position without
+// converting it, nullopt when only separators are left.
+std::optional<TokenSpan> ScanToken(std::string_view source, size_t position);
 
 TokenType GetType(const Token &token);
 
+SymbolId GetSymbolId(const Token &token);
+
 class Tokenizer {
   public:
     Tokenizer() = default;
 
-    Tokenizer(std::istream *in);
+    Tokenizer(std::string_view source);
 
-    void Update(std::istream *in);
+    void Update(std::string_view source);
 
     bool IsEnd();
 
@@ -86,6 +93,7 @@ class Tokenizer {
   private:
     int opened_ = 0;
 
-    std::istream *input_stream_ = nullptr;
+    std::string_view source_;
+    size_t position_ = 0;
     std::unique_ptr<Token> current_token_ = nullptr;
 };
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "base_object.h"
+#include "bytecode.h"
+#include "globals.h"
+#include "heap.h"
+#include "object.h"
+#include "profiler.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Stack machine running compiled code. Dispatch is direct threaded: the
+// first run of a Code object replaces its opcodes with the addresses of
+// their handlers, and every handler jumps straight to the next one.
+//
+// A call leaves the callee below its arguments; the arguments become the
+// first locals of the new frame, the other locals and the temporaries of
+// the body follow, and the result replaces the callee on return. A tail
+// call moves the callee and its arguments over the frame of the caller, so
+// only non-tail calls nest; their depth is bounded.
+//
+// Jumps and calls are safepoints: once the nursery is full, the heap is
+// collected there with the stack, the frames and the running code as roots.
+//
+// While the profiler is enabled, code is linked with handlers that count
+// the calls of builtins before going on to the usual ones.
+class VM : private Heap::RootSet {
+  public:
+    static constexpr size_t kMaxFrames = 1 << 18;
+
+    VM(Heap &heap, Globals &globals, Profiler &profiler);
+
+    VM(const VM &) = delete;
+    VM &operator=(const VM &) = delete;
+
+    ~VM();
+
+    Object::NodeType Execute(Code *code);
+
+  private:
+    static constexpr size_t kInitialStack = 1024;
+
+    // Where the caller continues once the callee returns.
+    struct Frame {
+        Code *code;
+        Closure *closure;
+        const uintptr_t *pc;
+        size_t fp;
+    };
+
+    // Nothing unless a safepoint is collecting.
+    void TraceRoots(Tracer &tracer) override;
+
+    Heap &heap_;
+    Globals &globals_;
+    Profiler &profiler_;
+    std::vector<Object::NodeType> stack_;
+    std::vector<Frame> frames_;
+    // while a safepoint collects: the used part of the stack and the frame
+    // being run, which is not in frames_
+    size_t live_ = 0;
+    Frame current_{};
+};